@@ -0,0 +1,155 @@
+% benchmark jsondecode
+%
+% results = jsondecodebench ()
+% results = jsondecodebench (scale)
+% results = jsondecodebench (scale, outfile)
+%
+% Decodes generated JSON texts of several shapes and sizes and reports one
+% JSON object per case (JSON Lines) on stdout or in OUTFILE.  SCALE
+% multiplies the sizes of the texts (default 1).  The fields are:
+%
+%   case           shape of the text
+%   n              number of records (elements, keys or nesting levels)
+%   bytes          size of the text
+%   reps           number of timed decodings
+%   wall_s         median time of a call of jsondecode
+%   decode_s       median time of the decoding alone, measured in C++
+%   overhead_s     wall_s - decode_s: call, copy and option parsing
+%   mb_per_s       bytes / decode_s / 1e6
+%   records_per_s  n / decode_s
+%   peak_rss_kb    peak resident set size of the process during the case,
+%                  NaN where the peak can't be reset before the case
+%
+% The texts are generated with jsonencode, so jsonencode.oct must be built
+% as well.  Run it from the repo's directory after compiling, e.g.
+%
+%   addpath ("benchmark"); jsondecodebench (1, "bench_output.txt");
+
+function results = jsondecodebench (scale, outfile)
+
+  if (nargin < 1)
+    scale = 1;
+  endif
+  if (nargin < 2)
+    outfile = "";
+  endif
+
+  if (isempty (outfile))
+    fid = stdout;
+  else
+    fid = fopen (outfile, "w");
+    if (fid < 0)
+      error ("jsondecodebench: unable to open '%s'", outfile);
+    endif
+  endif
+
+  rand ("seed", 42);
+  results = struct ([]);
+  for n = round (scale * [1e3, 1e4, 1e5])
+    cases = corpus (n);
+    for i = 1:rows (cases)
+      result = run_case (cases{i, :});
+      fprintf (fid, "%s\n", jsonencode (result));
+      fflush (fid);
+      results = [results; result];
+    endfor
+  endfor
+
+  if (fid != stdout)
+    fclose (fid);
+  endif
+
+endfunction
+
+% The texts of one size: name, text and number of records
+function cases = corpus (n)
+
+  cases = {};
+
+  x = rand (n, 1) * 1000;
+  cases(end+1, :) = {"numeric_short", ["[", sprintf("%.6g,", x)(1:end-1), "]"], n};
+  cases(end+1, :) = {"numeric_full", ["[", sprintf("%.17g,", x)(1:end-1), "]"], n};
+
+  k = max (1, round (sqrt (n / 10)));
+  cases(end+1, :) = {"matrix_nd", jsonencode(rand (k, k, 10)), k * k * 10};
+
+  names = arrayfun (@(i) sprintf ("user%d", mod (i, 100)), 1:n, "UniformOutput", false);
+  records = struct ("id", num2cell (1:n), "name", names,
+                    "value", num2cell (rand (1, n)),
+                    "ok", num2cell (rand (1, n) > 0.5),
+                    "tags", {{"a", "b"}});
+  cases(end+1, :) = {"records", jsonencode(records), n};
+
+  status = {"ok", "warning", "error", "timeout", "not found"};
+  cases(end+1, :) = {"strings", jsonencode(status(randi (numel (status), 1, n))), n};
+
+  d = min (n, 2000);
+  cases(end+1, :) = {"deep", [repmat('{"a":[', 1, d), "1", repmat("]}", 1, d)], d};
+
+  cases(end+1, :) = {"wide", ["{", sprintf('"k%d":%d,', [1:n; 1:n])(1:end-1), "}"], n};
+
+endfunction
+
+function result = run_case (name, json, records)
+
+  rss_reset = reset_peak_rss ();
+
+  % Estimate the time of one decoding to choose the number of repetitions
+  t = __jsondecode_bench__ (json, 1);
+  reps = max (3, min (50, ceil (0.5 / max (t, eps))));
+
+  wall = zeros (reps, 1);
+  for i = 1:reps
+    start = tic ();
+    jsondecode (json);
+    wall(i) = toc (start);
+  endfor
+  decode = __jsondecode_bench__ (json, reps);
+
+  result.case = name;
+  result.n = records;
+  result.bytes = numel (json);
+  result.reps = reps;
+  result.wall_s = median (wall);
+  result.decode_s = median (decode);
+  result.overhead_s = result.wall_s - result.decode_s;
+  result.mb_per_s = result.bytes / result.decode_s / 1e6;
+  result.records_per_s = records / result.decode_s;
+  if (rss_reset)
+    result.peak_rss_kb = peak_rss_kb ();
+  else
+    result.peak_rss_kb = NaN;
+  endif
+
+endfunction
+
+% Sets the peak resident set size of the process to the current one, so
+% that the next peak is the one of a single case (Linux 4.0 and later)
+function ok = reset_peak_rss ()
+
+  ok = false;
+  [fid, msg] = fopen ("/proc/self/clear_refs", "w");
+  if (fid < 0)
+    return;
+  endif
+  ok = fputs (fid, "5") >= 0;
+  ok = fclose (fid) == 0 && ok;
+
+endfunction
+
+% The peak resident set size from /proc, NaN where it isn't available
+function kb = peak_rss_kb ()
+
+  kb = NaN;
+  [fid, msg] = fopen ("/proc/self/status", "r");
+  if (fid < 0)
+    return;
+  endif
+  status = fread (fid, Inf, "*char")';
+  fclose (fid);
+  tok = regexp (status, 'VmHWM:\s*(\d+)', "tokens", "once");
+  if (! isempty (tok))
+    kb = str2double (tok{1});
+  endif
+
+endfunction
@@ -0,0 +1,114 @@
+% benchmark jsonencode
+%
+% results = jsonencodebench ()
+% results = jsonencodebench (scale)
+% results = jsonencodebench (scale, outfile)
+%
+% Encodes generated Octave values of several shapes and sizes, with the
+% shortest round-trip digits and with a few significant digits, and reports
+% one JSON object per case (JSON Lines) on stdout or in OUTFILE.  SCALE
+% multiplies the sizes of the values (default 1).  The fields are:
+%
+%   case           shape of the value
+%   digits         value of the "SignificantDigits" option, "shortest" for Inf
+%   n              number of elements or records
+%   bytes          size of the JSON text
+%   reps           number of timed encodings
+%   wall_s         median time of a call of jsonencode
+%   encode_s       median time of the encoding alone, measured in C++
+%   mb_per_s       bytes / encode_s / 1e6
+%   values_per_s   n / encode_s
+%
+% Run it from the repo's directory after compiling, e.g.
+%
+%   addpath ("benchmark"); jsonencodebench (1, "bench_output.txt");
+
+function results = jsonencodebench (scale, outfile)
+
+  if (nargin < 1)
+    scale = 1;
+  endif
+  if (nargin < 2)
+    outfile = "";
+  endif
+
+  if (isempty (outfile))
+    fid = stdout;
+  else
+    fid = fopen (outfile, "w");
+    if (fid < 0)
+      error ("jsonencodebench: unable to open '%s'", outfile);
+    endif
+  endif
+
+  rand ("seed", 42);
+  randn ("seed", 42);
+  results = struct ([]);
+  for n = round (scale * [1e3, 1e4, 1e5])
+    cases = corpus (n);
+    for i = 1:rows (cases)
+      for digits = [Inf, 7]
+        result = run_case (cases{i, :}, digits);
+        fprintf (fid, "%s\n", jsonencode (result));
+        fflush (fid);
+        results = [results; result];
+      endfor
+    endfor
+  endfor
+
+  if (fid != stdout)
+    fclose (fid);
+  endif
+
+endfunction
+
+% The values of one size: name, value and number of elements
+function cases = corpus (n)
+
+  cases = {};
+
+  cases(end+1, :) = {"doubles", randn(n, 1) * 1000, n};
+  cases(end+1, :) = {"singles", single (randn (n, 1)), n};
+
+  k = max (1, round (sqrt (n / 10)));
+  cases(end+1, :) = {"matrix_nd", rand (k, k, 10), k * k * 10};
+
+  cases(end+1, :) = {"int32_labels", int32 (randi (1e6, n, 1)), n};
+
+  records = struct ("id", num2cell (1:n),
+                    "value", num2cell (randn (1, n)),
+                    "name", {"name"});
+  cases(end+1, :) = {"records", records, n};
+
+endfunction
+
+function result = run_case (name, value, n, digits)
+
+  % Estimate the time of one encoding to choose the number of repetitions
+  [json, stats] = jsonencode (value, "SignificantDigits", digits);
+  reps = max (3, min (50, ceil (0.5 / max (stats.total_time, eps))));
+
+  wall = zeros (reps, 1);
+  encode = zeros (reps, 1);
+  for i = 1:reps
+    start = tic ();
+    [~, stats] = jsonencode (value, "SignificantDigits", digits);
+    wall(i) = toc (start);
+    encode(i) = stats.total_time;
+  endfor
+
+  result.case = name;
+  if (isinf (digits))
+    result.digits = "shortest";
+  else
+    result.digits = digits;
+  endif
+  result.n = n;
+  result.bytes = numel (json);
+  result.reps = reps;
+  result.wall_s = median (wall);
+  result.encode_s = median (encode);
+  result.mb_per_s = result.bytes / result.encode_s / 1e6;
+  result.values_per_s = n / result.encode_s;
+
+endfunction
@@ -23,13 +23,253 @@
 //
 ////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// jsondecodefile maps regular files into memory on POSIX systems
+#if ! defined (HAVE_MMAP) && (defined (__unix__) || defined (__APPLE__))
+#  define HAVE_MMAP 1
+#endif
+
+#if defined (HAVE_MMAP)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
 #include <octave/oct.h>
+#include <octave/lex.h>
 #include <octave/parse.h>
+#include "file-ops.h"
+#include "oct-string.h"
+// RapidJSON skips whitespace with SIMD instructions if the build targets them
+#if defined (__SSE4_2__)
+#  define RAPIDJSON_SSE42
+#elif defined (__SSE2__)
+#  define RAPIDJSON_SSE2
+#elif defined (__ARM_NEON)
+#  define RAPIDJSON_NEON
+#endif
+
 #include "rapidjson/document.h"
+#include "rapidjson/reader.h"
 #include "rapidjson/error/en.h"
+#include "rapidjson/filereadstream.h"
+#include "rapidjson/memorystream.h"
 
-octave_value
-decode (const rapidjson::Value& val, const octave_value_list& options);
+struct json_schema;
+
+//! Counters of a jsondecode call that are collected when its second output
+//! is requested.  The times are cumulative and in seconds; the time of a
+//! phase includes the phases nested in it, e.g. @c decode_time includes
+//! @c classify_time and @c names_time.
+
+struct decode_stats
+{
+  //! Time of the whole call.
+  double total_time = 0;
+
+  //! Time spent by RapidJSON parsing texts into DOMs.
+  double parse_time = 0;
+
+  //! Time spent converting DOMs, or parsing and converting with the
+  //! @c Streaming option, into Octave values.
+  double decode_time = 0;
+
+  //! Time spent by @ref classify_array.
+  double classify_time = 0;
+
+  //! Time spent by @ref make_valid_name on keys that aren't cached.
+  double names_time = 0;
+
+  //! Bytes of JSON text that were parsed.
+  std::size_t bytes = 0;
+
+  //! Values in the parsed DOMs, 0 with the @c Streaming option.
+  std::size_t dom_nodes = 0;
+
+  //! Largest memory in bytes used by the parser arena for one text.
+  std::size_t arena_peak = 0;
+
+  //! Texts that didn't fit in the buffers of the parser arena.
+  std::size_t arena_spills = 0;
+
+  //! Bytes that the parser allocated outside the buffers of the arena for
+  //! those texts.
+  std::size_t arena_spill_bytes = 0;
+
+  //! Texts decoded by @ref decode_numeric_text without RapidJSON.
+  std::size_t fast_numeric = 0;
+
+  //! Texts that started as numeric arrays but had to be parsed by
+  //! RapidJSON, e.g. because of a number outside the exact range.
+  std::size_t fast_numeric_fallbacks = 0;
+
+  //! Arrays written directly into numeric or logical arrays.
+  std::size_t nd_arrays = 0;
+
+  //! Arrays of objects decoded into struct arrays.
+  std::size_t struct_arrays = 0;
+
+  //! Arrays decoded through a Cell.
+  std::size_t cell_arrays = 0;
+
+  //! Keys whose field names are found in the cache.
+  std::size_t names_cached = 0;
+
+  //! Keys whose field names are made by @ref make_valid_name.
+  std::size_t names_made = 0;
+
+  //! Strings found in the cache of the @c InternStrings option.
+  std::size_t strings_interned = 0;
+
+  //! Returns the counters as a struct.
+  octave_scalar_map
+  map_value (void) const
+  {
+    octave_scalar_map retval;
+    retval.assign ("total_time", total_time);
+    retval.assign ("parse_time", parse_time);
+    retval.assign ("decode_time", decode_time);
+    retval.assign ("classify_time", classify_time);
+    retval.assign ("names_time", names_time);
+    retval.assign ("bytes", static_cast<double> (bytes));
+    retval.assign ("dom_nodes", static_cast<double> (dom_nodes));
+    retval.assign ("arena_peak", static_cast<double> (arena_peak));
+    retval.assign ("arena_spills", static_cast<double> (arena_spills));
+    retval.assign ("arena_spill_bytes",
+                   static_cast<double> (arena_spill_bytes));
+    retval.assign ("fast_numeric", static_cast<double> (fast_numeric));
+    retval.assign ("fast_numeric_fallbacks",
+                   static_cast<double> (fast_numeric_fallbacks));
+    retval.assign ("nd_arrays", static_cast<double> (nd_arrays));
+    retval.assign ("struct_arrays", static_cast<double> (struct_arrays));
+    retval.assign ("cell_arrays", static_cast<double> (cell_arrays));
+    retval.assign ("names_cached", static_cast<double> (names_cached));
+    retval.assign ("names_made", static_cast<double> (names_made));
+    retval.assign ("strings_interned",
+                   static_cast<double> (strings_interned));
+    return retval;
+  }
+};
+
+//! Options of a jsondecode call and the state shared by the decoding
+//! functions during that call.
+
+struct decode_options
+{
+  //! Name of the calling function used in error messages.
+  std::string who = "jsondecode";
+
+  //! @c ReplacementStyle option of @ref make_valid_name.
+  std::string replacement_style = "underscore";
+
+  //! @c Prefix option of @ref make_valid_name.
+  std::string prefix = "x";
+
+  //! Class of the decoded numbers: "double", "single", "int32", "int64"
+  //! or "auto".
+  std::string numeric_type = "double";
+
+  //! Paths of the values selected by the @c Select option, split into
+  //! their tokens.
+  std::vector<std::vector<std::string>> select;
+
+  //! The value of the @c Select option, a path or a cellstr of paths.
+  octave_value select_paths;
+
+  //! Schema compiled by jsonschema that the @c Schema option is set to.
+  std::shared_ptr<const json_schema> schema;
+
+  //! Use the SAX reader instead of the DOM.
+  bool streaming = false;
+
+  //! Decode a sequence of JSON texts separated by newlines (JSON Lines).
+  bool json_lines = false;
+
+  //! Number of JSON Lines records per batch, 0 means a single batch.
+  octave_idx_type batch_size = 0;
+
+  //! Function handle that is called with every batch of records.
+  octave_value batch_fcn;
+
+  //! Number of threads that parse the texts of a cellstr input.
+  int threads = 1;
+
+  //! Maximum nesting depth of objects and arrays.
+  int max_depth = std::numeric_limits<int>::max ();
+
+  //! True if equal strings share one character array.
+  bool intern_strings = false;
+
+  //! True if arrays of strings are decoded into codes and categories.
+  bool categorical = false;
+
+  //! Cache that maps raw JSON keys to valid Octave field names.
+  std::unordered_map<std::string, std::string> valid_names;
+
+  //! Cache of the decoded strings for the @c InternStrings option.
+  std::unordered_map<std::string, octave_value> strings;
+
+  //! Counters of the call, null unless they are requested.
+  decode_stats *stats = nullptr;
+};
+
+//! Adds the time of its scope to a phase of @ref decode_stats.  It does
+//! nothing if the counters aren't requested.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_stats stats;
+//! {
+//!   phase_timer timer (&stats, &decode_stats::parse_time);
+//!   // parse
+//! }
+//! @endcode
+
+class phase_timer
+{
+public:
+
+  phase_timer (decode_stats *stats, double decode_stats::*phase)
+    : m_time (stats ? &(stats->*phase) : nullptr), m_start ()
+  {
+    if (m_time)
+      m_start = std::chrono::steady_clock::now ();
+  }
+
+  phase_timer (const phase_timer&) = delete;
+
+  phase_timer& operator = (const phase_timer&) = delete;
+
+  ~phase_timer (void)
+  {
+    if (m_time)
+      *m_time += std::chrono::duration<double> (
+                   std::chrono::steady_clock::now () - m_start).count ();
+  }
+
+private:
+
+  double *m_time;
+
+  std::chrono::steady_clock::time_point m_start;
+};
 
 //! Checks if two instances of @ref string_vector are equal.
 //!
@@ -60,427 +300,4717 @@ equals (const string_vector& a, const string_vector& b)
   return true;
 }
 
-//! Decodes a numerical JSON value into a scalar number.
+//! The classes that numbers are decoded into.
+
+enum numeric_class
+{
+  double_class,
+  single_class,
+  int32_class,
+  int64_class
+};
+
+//! Chooses the class of a number or a numeric array from the
+//! @c NumericType option.  Integers are only used if all the values are
+//! integers that fit into them, otherwise the values are decoded as doubles.
 //!
-//! @param val JSON value that is guaranteed to be a numerical value.
+//! @param is_int32 @c bool that indicates if all the values fit in int32.
+//! @param is_int64 @c bool that indicates if all the values fit in int64.
+//! @param options @c NumericType option with its value.
 //!
-//! @return @ref octave_value that contains the numerical value of @p val.
+//! @return @ref numeric_class of the values.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("123");
-//! octave_value num = decode_number (d);
+//! decode_options options;
+//! options.numeric_type = "auto";
+//! numeric_class cls = output_class (false, true, options);
 //! @endcode
 
-octave_value
-decode_number (const rapidjson::Value& val)
-{
-  if (val.IsUint ())
-    return octave_value (val.GetUint ());
-  else if (val.IsInt ())
-    return octave_value (val.GetInt ());
-  else if (val.IsUint64 ())
-    return octave_value (val.GetUint64 ());
-  else if (val.IsInt64 ())
-    return octave_value (val.GetInt64 ());
-  else if (val.IsDouble ())
-    return octave_value (val.GetDouble ());
+numeric_class
+output_class (bool is_int32, bool is_int64, const decode_options& options)
+{
+  const std::string& type = options.numeric_type;
+  if (type == "double")
+    return double_class;
+  else if (type == "single")
+    return single_class;
+  else if (is_int32 && type != "int64")
+    return int32_class;
+  else if (is_int64 && type != "int32")
+    return int64_class;
   else
-    error ("jsondecode.cc: Unidentified type.");
+    return double_class;
 }
 
-//! Decodes a JSON object into a scalar struct.
+//! Creates a scalar number of the class chosen by @ref output_class.
 //!
-//! @param val JSON value that is guaranteed to be a JSON object.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
+//! @param value The value of the number.
+//! @param integer The value of the number if it fits in int64.
+//! @param is_int32 @c bool that indicates if the number fits in int32.
+//! @param is_int64 @c bool that indicates if the number fits in int64.
+//! @param options @c NumericType option with its value.
 //!
-//! @return @ref octave_value that contains the equivalent scalar struct of @p val.
+//! @return @ref octave_value that contains the number.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("{\"a\": 1, \"b\": 2}");
-//! octave_value struct = decode_object (d, octave_value_list ());
+//! decode_options options;
+//! octave_value num = make_number (123, 123, true, true, options);
 //! @endcode
 
 octave_value
-decode_object (const rapidjson::Value& val, const octave_value_list& options)
+make_number (double value, int64_t integer, bool is_int32, bool is_int64,
+             const decode_options& options)
 {
-  octave_scalar_map retval;
-  for (const auto& pair : val.GetObject ())
+  switch (output_class (is_int32, is_int64, options))
     {
-      std::string fcn_name = "matlab.lang.makeValidName";
-      octave_value_list args = octave_value_list (pair.name.GetString ());
-      args.append (options);
-      std::string validName = octave::feval (fcn_name,args)(0).string_value ();
-      retval.assign (validName, decode (pair.value, options));
+    case int32_class:
+      return octave_value (octave_int32 (integer));
+    case int64_class:
+      return octave_value (octave_int64 (integer));
+    case single_class:
+      return octave_value (static_cast<float> (value));
+    default:
+      return octave_value (value);
     }
-  return octave_value (retval);
 }
 
-//! Decodes a JSON array that contains only numerical or null values
-//! into an NDArray.
+//! Decodes a numerical JSON value into a scalar number.
 //!
-//! @param val JSON value that is guaranteed to be a numeric array.
+//! @param val JSON value that is guaranteed to be a numerical value.
+//! @param options @c NumericType option with its value.
 //!
-//! @return @ref octave_value that contains the equivalent NDArray of @p val.
+//! @return @ref octave_value that contains the numerical value of @p val.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
+//! decode_options options;
 //! rapidjson::Document d;
-//! d.Parse ("[1, 2, 3, 4]");
-//! octave_value numeric_array = decode_numeric_array (d);
+//! d.Parse ("123");
+//! octave_value num = decode_number (d, options);
 //! @endcode
 
 octave_value
-decode_numeric_array (const rapidjson::Value& val)
+decode_number (const rapidjson::Value& val, const decode_options& options)
 {
-  NDArray retval (dim_vector (val.Size (), 1));
-  octave_idx_type index = 0;
-  for (const auto& elem : val.GetArray ())
-    retval(index++) = elem.IsNull () ? octave_NaN
-                                     : decode_number (elem).double_value ();
-  return retval;
+  bool is_int64 = val.IsInt64 ();
+  return make_number (val.GetDouble (), is_int64 ? val.GetInt64 () : 0,
+                      val.IsInt (), is_int64, options);
 }
 
-//! Decodes a JSON array that contains only boolean values into a boolNDArray.
+//! Converts an innermost value of a numeric or boolean N-D JSON array
+//! into an element of the output array.
 //!
-//! @param val JSON value that is guaranteed to be a boolean array.
+//! @param val JSON value that is guaranteed to be a number, null or boolean.
+//! Null values are only converted into floating point elements and the
+//! values converted into integers are guaranteed to fit in them.
 //!
-//! @return @ref octave_value that contains the equivalent boolNDArray of @p val.
+//! @return The value of the element.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! rapidjson::Document d;
-//! d.Parse ("[true, false, true]");
-//! octave_value boolean_array = decode_boolean_array (d);
+//! d.Parse ("null");
+//! double value = element_value<double> (d);
 //! @endcode
 
-octave_value
-decode_boolean_array (const rapidjson::Value& val)
+template <typename T> T
+element_value (const rapidjson::Value& val);
+
+template <> double
+element_value<double> (const rapidjson::Value& val)
 {
-  boolNDArray retval (dim_vector (val.Size (), 1));
-  octave_idx_type index = 0;
-  for (const auto& elem : val.GetArray ())
-    retval(index++) = elem.GetBool ();
-  return retval;
+  return val.IsNull () ? octave_NaN : val.GetDouble ();
 }
 
-//! Decodes a JSON array that contains different types
-//! or string values only into a Cell.
-//!
-//! @param val JSON value that is guaranteed to be a mixed or string array.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
-//!
-//! @return @ref octave_value that contains the equivalent Cell of @p val.
+template <> float
+element_value<float> (const rapidjson::Value& val)
+{
+  return val.IsNull () ? octave_Float_NaN : val.GetDouble ();
+}
+
+template <> octave_int32
+element_value<octave_int32> (const rapidjson::Value& val)
+{
+  return val.GetInt ();
+}
+
+template <> octave_int64
+element_value<octave_int64> (const rapidjson::Value& val)
+{
+  return val.GetInt64 ();
+}
+
+template <> bool
+element_value<bool> (const rapidjson::Value& val)
+{
+  return val.GetBool ();
+}
+
+//! Decodes the characters of a JSON string into a character vector.
+//! The characters are copied once, directly from the parsed text.
 //!
-//! @b Example (decoding a string array):
+//! @param str Pointer to the characters of the string.
+//! @param length The number of characters in @p str.
 //!
-//! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[\"foo\", \"bar\", \"baz\"]");
-//! octave_value cell = decode_string_and_mixed_array (d, octave_value_list ());
-//! @endcode
+//! @return @ref octave_value that contains the character vector.
 //!
-//! @b Example (decoding a mixed array):
+//! @b Example:
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[\"foo\", 123, true]");
-//! octave_value cell = decode_string_and_mixed_array (d, octave_value_list ());
+//! octave_value str = decode_string ("foo", 3);
 //! @endcode
 
 octave_value
-decode_string_and_mixed_array (const rapidjson::Value& val,
-                               const octave_value_list& options)
+decode_string (const char *str, std::size_t length)
 {
-  Cell retval (dim_vector (val.Size (), 1));
-  octave_idx_type index = 0;
-  for (const auto& elem : val.GetArray ())
-    retval(index++) = decode (elem, options);
-  return retval;
+  // Empty strings are 0x0 character arrays
+  charNDArray retval (dim_vector (length ? 1 : 0, length));
+  std::copy (str, str + length, retval.fortran_vec ());
+  return octave_value (retval, '\'');
 }
 
-//! Decodes a JSON array that contains only objects into a Cell or a struct array
-//! depending on the similarity of the objects' keys.
-//!
-//! @param val JSON value that is guaranteed to be an object array.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
-//!
-//! @return @ref octave_value that contains the equivalent Cell
-//! or struct array of @p val.
+//! Checks if a string is a valid Octave variable name.
 //!
-//! @b Example (returns a struct array):
+//! @param str The string to be checked.
 //!
-//! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[{\"a\":1,\"b\":2},{\"a\":3,\"b\":4}]");
-//! octave_value object_array = decode_object_array (d, octave_value_list ());
-//! @endcode
+//! @return @c bool that indicates if @p str is a valid variable name.
 //!
-//! @b Example (returns a Cell):
+//! @b Example:
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4}]");
-//! octave_value object_array = decode_object_array (d, octave_value_list ());
+//! bool is_valid = is_valid_name ("foo_1");
 //! @endcode
 
-octave_value
-decode_object_array (const rapidjson::Value& val,
-                     const octave_value_list& options)
+bool
+is_valid_name (const std::string& str)
 {
-  Cell struct_cell = decode_string_and_mixed_array (val, options).cell_value ();
-  string_vector field_names = struct_cell(0).scalar_map_value ().fieldnames ();
-  bool same_field_names = 1;
-  for (octave_idx_type i = 1; i < struct_cell.numel (); ++i)
-    if (! equals (field_names, struct_cell(i).scalar_map_value ().fieldnames ()))
-      {
-        same_field_names = 0;
-        break;
-      }
-  if (same_field_names)
-    {
-      octave_map struct_array;
-      Cell value (dim_vector (struct_cell.numel (), 1));
-      for (octave_idx_type i = 0; i < field_names.numel (); ++i)
-        {
-          for (octave_idx_type k = 0; k < struct_cell.numel (); ++k)
-            value(k) = struct_cell(k).scalar_map_value ().getfield (field_names(i));
-          struct_array.assign (field_names(i), value);
-        }
-      return octave_value (struct_array);
-    }
-  else
-    return struct_cell;
+  if (str.empty () || ! (std::isalpha (static_cast<unsigned char> (str[0]))
+                         || str[0] == '_'))
+    return false;
+  for (unsigned char c : str)
+    if (! (std::isalnum (c) || c == '_'))
+      return false;
+
+  return ! octave::iskeyword (str);
 }
 
-//! Decodes a JSON array that contains only arrays into a Cell or an NDArray
-//! depending on the dimensions and the elements' type of the sub arrays.
+//! Converts a string into a valid Octave variable name following the rules
+//! of @ref matlab.lang.makeValidName.
 //!
-//! @param val JSON value that is guaranteed to be an array of arrays.
+//! @param str The string to be converted. It is modified in place.
 //! @param options @c ReplacementStyle and @c Prefix options with their values.
 //!
-//! @return @ref octave_value that contains the equivalent Cell
-//! or NDArray of @p val.
-//!
-//! @b Example (returns an NDArray):
-//!
-//! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[[1, 2], [3, 4]]");
-//! octave_value array = decode_array_of_arrays (d, octave_value_list ());
-//! @endcode
-//!
-//! @b Example (returns a Cell):
+//! @b Example:
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[[1, 2], [3, 4, 5]]");
-//! octave_value cell = decode_array_of_arrays (d, octave_value_list ());
+//! decode_options options;
+//! std::string name = "1 field";
+//! make_valid_name (name, options);
 //! @endcode
 
-octave_value
-decode_array_of_arrays (const rapidjson::Value& val,
-                        const octave_value_list& options)
+void
+make_valid_name (std::string& str, const decode_options& options)
 {
-  // Some arrays should be decoded as NDArrays and others as cell arrays
-  Cell cell = decode_string_and_mixed_array(val, options).cell_value ();
-  // Only arrays with sub arrays of booleans and numericals will return NDArray
-  bool is_bool = cell(0).is_bool_matrix ();
-  dim_vector sub_array_dims = cell(0).dims ();
-  octave_idx_type sub_array_ndims = cell(0).ndims ();
-  octave_idx_type cell_numel = cell.numel ();
-  for (octave_idx_type i = 0; i < cell_numel; ++i)
+  auto is_valid_char = [] (unsigned char c)
+                         { return std::isalnum (c) || c == '_'; };
+
+  // If the string is already a valid variable name, nothing has to change
+  if (is_valid_name (str))
+    return;
+
+  // Change whitespace followed by a letter to uppercase, except for the
+  // whitespace at the beginning of the string
+  bool previous_is_space = false;
+  bool any_non_space = false;
+  for (char& c : str)
     {
-      // If one element is cell return the cell array as at least one of
-      // the sub arrays area either an array of: strings, objects or mixed array
-      if (cell(i).iscell ())
-        return cell;
-      // If not the same dim of elements or dim = 0 return cell array
-      if (cell(i).dims () != sub_array_dims || sub_array_dims == dim_vector ())
-        return cell;
-      // If not numeric sub arrays only or bool
-      // sub arrays only return cell array
-      if(cell(i).is_bool_matrix () != is_bool)
-        return cell;
+      unsigned char uc = static_cast<unsigned char> (c);
+      if (any_non_space && previous_is_space && std::isalpha (uc))
+        c = std::toupper (uc);
+      previous_is_space = std::isspace (uc);
+      any_non_space |= ! previous_is_space;
     }
-  // Calculate the dims of the output array
-  dim_vector array_dims;
-	array_dims.resize (sub_array_ndims + 1);
-	array_dims(0) = cell_numel;
-	for (auto i = 1; i < sub_array_ndims + 1; i++)
-  	array_dims(i) = sub_array_dims(i-1);
-  NDArray array (array_dims);
 
-  // Populate the array with specific order to generate MATLAB-identical output
-  octave_idx_type array_index = 0;
-  for (octave_idx_type i = 0; i < array.numel () / cell_numel; ++i)
-    for (octave_idx_type k = 0; k < cell_numel; ++k)
-      array(array_index++) = cell(k).array_value ()(i);
-  return array;
+  // Remove any whitespace
+  str.erase (std::remove_if (str.begin (), str.end (),
+                             [] (unsigned char c) { return std::isspace (c); }),
+             str.end ());
+  if (str.empty ())
+    str = options.prefix;
+
+  // Add the prefix and capitalize the first character of keywords
+  if (octave::iskeyword (str))
+    {
+      str[0] = std::toupper (static_cast<unsigned char> (str[0]));
+      str = options.prefix + str;
+    }
+
+  // Add the prefix if the first character is not a letter or underscore
+  if (! std::isalpha (static_cast<unsigned char> (str[0])) && str[0] != '_')
+    str = options.prefix + str;
+
+  // Replace the invalid characters depending on the replacement style
+  if (options.replacement_style == "underscore")
+    std::replace_if (str.begin (), str.end (),
+                     [&] (unsigned char c) { return ! is_valid_char (c); },
+                     '_');
+  else if (options.replacement_style == "delete")
+    str.erase (std::remove_if (str.begin (), str.end (),
+                               [&] (unsigned char c)
+                                 { return ! is_valid_char (c); }),
+               str.end ());
+  else
+    {
+      std::string hex_str;
+      for (char c : str)
+        if (is_valid_char (c))
+          hex_str += c;
+        else
+          {
+            char hex[5];
+            std::snprintf (hex, sizeof (hex), "0x%02X",
+                           static_cast<unsigned char> (c));
+            hex_str += hex;
+          }
+      str = hex_str;
+    }
 }
 
-//! Decodes any type of JSON arrays. This function only serves as an interface
-//! by choosing which function to call from the previous functions.
+//! Returns the valid Octave field name of a JSON key. The names are cached
+//! in @p options, so a key that is shared by many objects is converted only
+//! once per call of jsondecode.
 //!
-//! @param val JSON value that is guaranteed to be an array.
+//! @param key Pointer to the characters of the key.
+//! @param length The number of characters in @p key.
 //! @param options @c ReplacementStyle and @c Prefix options with their values.
 //!
-//! @return @ref octave_value that contains the output of decoding @p val.
+//! @return The valid field name of @p key.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[[1, 2], [3, 4, 5]]");
-//! octave_value array = decode_array (d, octave_value_list ());
+//! decode_options options;
+//! std::string name = valid_name ("1 field", 7, options);
 //! @endcode
 
-octave_value
-decode_array (const rapidjson::Value& val, const octave_value_list& options)
+const std::string&
+valid_name (const char *key, std::size_t length, decode_options& options)
 {
-  // Handle empty arrays
-  if (val.Empty ())
-    return NDArray (dim_vector (0,0));
-
-  // Compare with other elements to know if the array has multiple types
-  rapidjson::Type array_type = val[0].GetType ();
-  // Check if the array is numeric and if it has multible types
-  bool same_type = 1, is_numeric = 1;
-  for (const auto& elem : val.GetArray ())
-    {
-      rapidjson::Type current_elem_type = elem.GetType ();
-      if (is_numeric && ! (current_elem_type == rapidjson::kNullType
-          || current_elem_type == rapidjson::kNumberType))
-        is_numeric = 0;
-      if (same_type && (current_elem_type != array_type))
-        // RapidJSON doesn't have kBoolean Type it has kTrueType and kFalseType
-        if (! ((current_elem_type == rapidjson::kTrueType
-                && array_type == rapidjson::kFalseType)
-            || (current_elem_type == rapidjson::kFalseType
-                && array_type == rapidjson::kTrueType)))
-          same_type = 0;
-    }
-  if (is_numeric)
-    return decode_numeric_array (val);
-  if (same_type && (array_type != rapidjson::kStringType))
-    {
-      if (array_type == rapidjson::kTrueType
-          || array_type == rapidjson::kFalseType)
-        return decode_boolean_array (val);
-      else if (array_type == rapidjson::kObjectType)
-        return decode_object_array (val, options);
-      else if (array_type == rapidjson::kArrayType)
-        return decode_array_of_arrays (val, options);
-      else
-        error ("jsondecode.cc: Unidentified type.");
+  std::string raw_key (key, length);
+  auto it = options.valid_names.find (raw_key);
+  if (it != options.valid_names.end ())
+    {
+      if (options.stats)
+        options.stats->names_cached++;
+      return it->second;
     }
-  else
-    return decode_string_and_mixed_array (val, options);
+
+  phase_timer timer (options.stats, &decode_stats::names_time);
+  if (options.stats)
+    options.stats->names_made++;
+  std::string name = raw_key;
+  make_valid_name (name, options);
+  return options.valid_names.emplace (raw_key, name).first->second;
 }
 
-//! Decodes any JSON value. This function only serves as an interface
-//! by choosing which function to call from the previous functions.
+//! Decodes a JSON string into a character vector.  With the
+//! @c InternStrings option, equal strings are decoded once per call of
+//! jsondecode and share the same character array, which saves memory and
+//! time for columns with few distinct values.
 //!
-//! @param val JSON value.
-//! @param options @c ReplacementStyle and @c Prefix options with their values.
+//! @param str Pointer to the characters of the string.
+//! @param length The number of characters in @p str.
+//! @param options @c InternStrings option with its value.
 //!
-//! @return @ref octave_value that contains the output of decoding @p val.
+//! @return @ref octave_value that contains the character vector.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
-//! rapidjson::Document d;
-//! d.Parse ("[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4}]");
-//! octave_value value = decode (d, octave_value_list ());
+//! decode_options options;
+//! options.intern_strings = true;
+//! octave_value str = string_value ("foo", 3, options);
 //! @endcode
 
 octave_value
-decode (const rapidjson::Value& val, const octave_value_list& options)
+string_value (const char *str, std::size_t length, decode_options& options)
 {
-  if (val.IsBool ())
-    return val.GetBool ();
-  else if (val.IsNumber ())
-    return decode_number (val);
-  else if (val.IsString ())
-    return val.GetString ();
-  else if (val.IsObject ())
-    return decode_object (val, options);
-  else if (val.IsNull ())
-    return NDArray (dim_vector (0,0));
-  else if (val.IsArray ())
-    return decode_array (val, options);
-  else
-    error ("jsondecode.cc: Unidentified type.");
-}
-
-DEFUN_DLD (jsondecode, args, ,
-           doc: /* -*- texinfo -*-
-@deftypefn  {} {@var{object} =} jsondecode (@var{json})
-@deftypefnx {} {@var{object} =} jsondecode (@var{json}, "ReplacementStyle", @var{rs})
-@deftypefnx {} {@var{object} =} jsondecode (@var{json}, "Prefix", @var{pfx})
-@deftypefnx {} {@var{object} =} jsondecode (@var{json}, @dots{})
+  if (! options.intern_strings)
+    return decode_string (str, length);
 
-Decode text that is formatted in JSON.
+  std::string raw (str, length);
+  auto it = options.strings.find (raw);
+  if (it != options.strings.end ())
+    {
+      if (options.stats)
+        options.stats->strings_interned++;
+      return it->second;
+    }
 
-The input @var{json} is a string that contains JSON text.
-The output @var{object} is an Octave object that contains the result
-of decoding @var{json}.
+  octave_value value = decode_string (str, length);
+  options.strings.emplace (raw, value);
+  return value;
+}
 
-For more information about the options @qcode{"ReplacementStyle"} and
-@qcode{"Prefix"}, see @ref{matlab.lang.makeValidName}.
+//! Summary of a JSON array that is computed once by @ref classify_array
+//! and used by the decoders of arrays instead of scanning the array again.
 
--NOTE: It is not guaranteed to get the same JSON text if you decode
-and then encode it as some names may change by @ref{matlab.lang.makeValidName}.
+struct array_info
+{
+  //! The kind of the elements of a JSON array.
+  enum element_kind
+  {
+    empty,
+    numeric,
+    boolean,
+    object,
+    array,
+    string,
+    mixed
+  };
 
-This table shows the conversions from JSON data types to Octave data types:
+  //! The kind that all the elements have, numbers and null values are
+  //! numeric.
+  element_kind kind = empty;
 
-@table @asis
-@item @qcode{"Boolean"}
-Scalar @qcode{"logical"}
+  //! True if the array is decoded into an NDArray or a boolNDArray.
+  bool is_nd = false;
 
-@item @qcode{"Number"}
-Scalar @qcode{"double"}
+  //! True if the array is decoded into a boolNDArray.
+  bool is_bool = false;
 
-@item @qcode{"String"}
-@qcode{"Vector"} of chars
+  //! True if all the numbers fit in int32, for the @c NumericType option.
+  bool is_int32 = false;
 
-@item JSON @qcode{"Object"}
-Scalar @qcode{"struct"} (field names of the struct may be different from
-the keys of the JSON object due to @ref{matlab.lang.makeValidName})
+  //! True if all the numbers fit in int64, for the @c NumericType option.
+  bool is_int64 = false;
 
-@item @qcode{"Array"} of different data types
-@qcode{"Cell"} array
+  //! The dimensions of the NDArray or boolNDArray.
+  dim_vector dims;
 
-@item @qcode{"Array"} of booleans
-@qcode{"Array"} of logicals
+  //! The maximum nesting depth of arrays, 1 for an array of scalars.
+  int depth = 1;
 
-@item @qcode{"Array"} of numbers
-@qcode{"Array"} of doubles
+  //! The summaries of the sub arrays in their order in the array.  They are
+  //! dropped if the array is decoded into an NDArray or a boolNDArray.
+  std::vector<array_info> children;
+};
 
-@item @qcode{"Array"} of strings
-@qcode{"Cell"} array of vectors of chars
+//! Completes the summary of a JSON array after all its elements have been
+//! classified by @ref classify_array.
+//!
+//! @param numel The number of elements of the array.
+//! @param info The summary of the array.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! array_info info;
+//! info.kind = array_info::numeric;
+//! summarize_array (3, info);
+//! @endcode
 
-@item @qcode{"Array"} of JSON objects (All objects have the same field names)
-@qcode{"Struct array"}
+void
+summarize_array (octave_idx_type numel, array_info& info)
+{
+  switch (info.kind)
+    {
+    case array_info::empty:
+      // Empty arrays are decoded into 0x0 arrays that can't be combined
+      info.is_nd = true;
+      info.is_bool = false;
+      info.dims = dim_vector (0, 0);
+      break;
 
-@item @qcode{"Array"} of JSON objects (Objects have different field names)
-@qcode{"Cell"} array of scalar structs
+    case array_info::numeric:
+    case array_info::boolean:
+      info.is_nd = true;
+      info.is_bool = (info.kind == array_info::boolean);
+      info.dims = dim_vector (numel, 1);
+      break;
 
-@item @qcode{"null"} inside a numeric array
-@qcode{"NaN"}
+    case array_info::array:
+      {
+        // Sub arrays are combined if they are all numeric or all boolean
+        // N-D arrays with the same non empty dimensions
+        const array_info& first = info.children[0];
+        info.is_nd = first.is_nd && first.dims != dim_vector (0, 0);
+        for (const auto& child : info.children)
+          if (! child.is_nd || child.is_bool != first.is_bool
+              || child.dims != first.dims)
+            {
+              info.is_nd = false;
+              break;
+            }
+          else
+            {
+              info.is_int32 = info.is_int32 && child.is_int32;
+              info.is_int64 = info.is_int64 && child.is_int64;
+            }
 
-@item @qcode{"null"} inside a non-numeric array
-Empty @qcode{"Array"} of doubles (@qcode{"[]"})
-@end table
+        if (info.is_nd)
+          {
+            info.is_bool = first.is_bool;
+            int sub_ndims = first.dims.ndims ();
+            info.dims.resize (sub_ndims + 1);
+            info.dims(0) = numel;
+            for (int i = 0; i < sub_ndims; ++i)
+              info.dims(i+1) = first.dims(i);
+            info.dims.chop_trailing_singletons ();
+            info.children.clear ();
+          }
+      }
+      break;
 
-Examples:
+    default:
+      info.is_nd = false;
+      break;
+    }
+}
+
+//! Computes the summary of a JSON array in one bottom-up pass over the
+//! array and its sub arrays.  The dimensions of a sub array are the
+//! dimensions it is decoded into, so that sub arrays with the same
+//! dimensions can be combined like @ref combine_sub_arrays does.  The sub
+//! arrays are visited with an explicit stack, so deeply nested arrays don't
+//! overflow the call stack.
+//!
+//! @param val JSON value that is guaranteed to be an array.
+//! @param info The summary of @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document d;
+//! d.Parse ("[[1, 2], [3, 4]]");
+//! array_info info;
+//! classify_array (d, info);
+//! @endcode
+
+void
+classify_array (const rapidjson::Value& val, array_info& info)
+{
+  // The arrays whose elements are being classified, the innermost last
+  struct level
+  {
+    const rapidjson::Value *val;
+    array_info *info;
+    rapidjson::SizeType next;
+  };
+
+  auto reset = [] (array_info& summary)
+    {
+      summary.kind = array_info::empty;
+      summary.is_int32 = true;
+      summary.is_int64 = true;
+      summary.depth = 1;
+      summary.children.clear ();
+    };
+
+  reset (info);
+  std::vector<level> stack (1, {&val, &info, 0});
+  while (! stack.empty ())
+    {
+      level& top = stack.back ();
+      array_info& current = *top.info;
+      if (top.next < top.val->Size ())
+        {
+          const rapidjson::Value& elem = (*top.val)[top.next++];
+          array_info::element_kind kind;
+          switch (elem.GetType ())
+            {
+            case rapidjson::kNullType:
+            case rapidjson::kNumberType:
+              kind = array_info::numeric;
+              current.is_int32 = current.is_int32 && elem.IsInt ();
+              current.is_int64 = current.is_int64 && elem.IsInt64 ();
+              break;
+            case rapidjson::kTrueType:
+            case rapidjson::kFalseType:
+              kind = array_info::boolean;
+              break;
+            case rapidjson::kObjectType:
+              kind = array_info::object;
+              break;
+            case rapidjson::kArrayType:
+              kind = array_info::array;
+              break;
+            default:
+              kind = array_info::string;
+              break;
+            }
+          if (current.kind == array_info::empty)
+            current.kind = kind;
+          else if (current.kind != kind)
+            current.kind = array_info::mixed;
+
+          // The summary of a sub array is finished before the next element
+          if (kind == array_info::array)
+            {
+              current.children.emplace_back ();
+              reset (current.children.back ());
+              stack.push_back ({&elem, &current.children.back (), 0});
+            }
+          continue;
+        }
+
+      summarize_array (top.val->Size (), current);
+      stack.pop_back ();
+      if (! stack.empty ())
+        stack.back ().info->depth = std::max (stack.back ().info->depth,
+                                              current.depth + 1);
+    }
+}
+
+//! Finds the field names of the scalar struct that a JSON object is decoded
+//! into and the field that each member of the object is stored in.
+//! Members that have the same valid name are stored in the same field.
+//!
+//! @param val JSON value that is guaranteed to be a JSON object.
+//! @param options @c ReplacementStyle and @c Prefix options with their values.
+//! @param field_names The field names in the order of their first appearance.
+//! @param member_fields The index in @p field_names of each member of @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! rapidjson::Document d;
+//! d.Parse ("{\"a\": 1, \"b\": 2, \"a\": 3}");
+//! std::vector<std::string> field_names;
+//! std::vector<octave_idx_type> member_fields;
+//! object_layout (d, options, field_names, member_fields);
+//! @endcode
+
+void
+object_layout (const rapidjson::Value& val, decode_options& options,
+               std::vector<std::string>& field_names,
+               std::vector<octave_idx_type>& member_fields)
+{
+  std::unordered_map<std::string, octave_idx_type> field_index;
+  field_names.clear ();
+  member_fields.clear ();
+  for (const auto& pair : val.GetObject ())
+    {
+      const std::string& name = valid_name (pair.name.GetString (),
+                                            pair.name.GetStringLength (),
+                                            options);
+      octave_idx_type next_index = field_names.size ();
+      auto it = field_index.emplace (name, next_index).first;
+      if (it->second == next_index)
+        field_names.push_back (name);
+      member_fields.push_back (it->second);
+    }
+}
+
+//! Checks if two JSON objects have the same keys in the same order.
+//!
+//! @param a JSON value that is guaranteed to be a JSON object.
+//! @param b JSON value that is guaranteed to be a JSON object.
+//!
+//! @return @c bool that indicates if they have the same keys.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document a, b;
+//! a.Parse ("{\"a\": 1, \"b\": 2}");
+//! b.Parse ("{\"a\": 3, \"b\": 4}");
+//! bool is_same = same_keys (a, b);
+//! @endcode
+
+bool
+same_keys (const rapidjson::Value& a, const rapidjson::Value& b)
+{
+  if (a.MemberCount () != b.MemberCount ())
+    return false;
+  for (auto it_a = a.MemberBegin (), it_b = b.MemberBegin ();
+       it_a != a.MemberEnd (); ++it_a, ++it_b)
+    if (it_a->name != it_b->name)
+      return false;
+
+  return true;
+}
+
+//! Creates a scalar struct from its field names and values at once, so
+//! objects with many keys aren't built by looking up each key in a growing
+//! struct.
+//!
+//! @param names The field names, without duplicates.
+//! @param values The value of each field.
+//!
+//! @return The scalar struct.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! std::vector<std::string> names = {"a", "b"};
+//! std::vector<octave_value> values = {1.0, 2.0};
+//! octave_scalar_map map = make_scalar_map (names, values);
+//! @endcode
+
+octave_scalar_map
+make_scalar_map (const std::vector<std::string>& names,
+                 const std::vector<octave_value>& values)
+{
+  octave_idx_type nfields = names.size ();
+  string_vector keys (nfields);
+  for (octave_idx_type i = 0; i < nfields; ++i)
+    keys(i) = names[i];
+
+  octave_scalar_map retval (keys);
+  for (octave_idx_type i = 0; i < nfields; ++i)
+    retval.contents (i) = values[i];
+  return retval;
+}
+
+//! Writes the values of a JSON array that is decoded into an N-D array into
+//! the column-major data of the output array.  Element i of the sub array
+//! k is element k + i * n of an array with n sub arrays, so each level
+//! multiplies the distance between the elements of a sub array by its size.
+//! The sub arrays are visited with an explicit stack.
+//!
+//! @param val JSON value that is decoded into an N-D array as found by
+//! @ref classify_array.
+//! @param data Pointer to the data of the output array.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document d;
+//! d.Parse ("[[1, 2], [3, 4]]");
+//! NDArray array (dim_vector (2, 2));
+//! fill_array (d, array.fortran_vec ());
+//! @endcode
+
+template <typename T> void
+fill_array (const rapidjson::Value& val, T *data)
+{
+  // The index in data of the first element of an array and the distance
+  // between two consecutive elements
+  struct level
+  {
+    const rapidjson::Value *val;
+    octave_idx_type offset;
+    octave_idx_type stride;
+  };
+
+  std::vector<level> stack (1, {&val, 0, 1});
+  while (! stack.empty ())
+    {
+      level top = stack.back ();
+      stack.pop_back ();
+      octave_idx_type numel = top.val->Size ();
+      octave_idx_type offset = top.offset;
+      if ((*top.val)[0].IsArray ())
+        for (const auto& elem : top.val->GetArray ())
+          {
+            stack.push_back ({&elem, offset, top.stride * numel});
+            offset += top.stride;
+          }
+      else
+        for (const auto& elem : top.val->GetArray ())
+          {
+            data[offset] = element_value<T> (elem);
+            offset += top.stride;
+          }
+    }
+}
+
+//! Decodes a JSON array of numbers or booleans, or of sub arrays that are
+//! combined into one N-D array, into an N-D array of the class chosen by
+//! the @c NumericType option or a boolNDArray.
+//!
+//! @param val JSON value that is decoded into an N-D array as found by
+//! @ref classify_array.
+//! @param info The summary of @p val found by @ref classify_array.
+//! @param options @c NumericType option with its value.
+//!
+//! @return @ref octave_value that contains the N-D array.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! rapidjson::Document d;
+//! d.Parse ("[1, 2, null]");
+//! array_info info;
+//! classify_array (d, info);
+//! octave_value array = decode_nd_array (d, info, options);
+//! @endcode
+
+octave_value
+decode_nd_array (const rapidjson::Value& val, const array_info& info,
+                 const decode_options& options)
+{
+  if (info.is_bool)
+    {
+      boolNDArray array (info.dims);
+      fill_array (val, array.fortran_vec ());
+      return array;
+    }
+
+  switch (output_class (info.is_int32, info.is_int64, options))
+    {
+    case int32_class:
+      {
+        int32NDArray array (info.dims);
+        fill_array (val, array.fortran_vec ());
+        return array;
+      }
+    case int64_class:
+      {
+        int64NDArray array (info.dims);
+        fill_array (val, array.fortran_vec ());
+        return array;
+      }
+    case single_class:
+      {
+        FloatNDArray array (info.dims);
+        fill_array (val, array.fortran_vec ());
+        return array;
+      }
+    default:
+      {
+        NDArray array (info.dims);
+        fill_array (val, array.fortran_vec ());
+        return array;
+      }
+    }
+}
+
+//! Merges decoded sub arrays of the same dimensions into one N-D array
+//! whose first dimension indexes the sub arrays.
+//!
+//! @param cell Cell that contains the decoded sub arrays.
+//! @param array_dims The dimensions of the output array.
+//!
+//! @return The merged N-D array.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! Cell cell (dim_vector (2, 1));
+//! cell(0) = NDArray (dim_vector (2, 1), 1);
+//! cell(1) = NDArray (dim_vector (2, 1), 2);
+//! NDArray array = merge_sub_arrays<NDArray> (cell, dim_vector (2, 2));
+//! @endcode
+
+template <typename T> T
+merge_sub_arrays (const Cell& cell, const dim_vector& array_dims)
+{
+  T array (array_dims);
+  octave_idx_type cell_numel = cell.numel ();
+  octave_idx_type sub_array_numel = array.numel () / cell_numel;
+  // Populate the array with specific order to generate MATLAB-identical output
+  for (octave_idx_type k = 0; k < cell_numel; ++k)
+    {
+      T sub_array = octave_value_extract<T> (cell(k));
+      for (octave_idx_type i = 0; i < sub_array_numel; ++i)
+        array.xelem (k + i * cell_numel) = sub_array.xelem (i);
+    }
+  return array;
+}
+
+//! Combines the decoded sub arrays of a JSON array of arrays into a numeric
+//! N-D array or a boolNDArray if they are numeric or boolean arrays of the
+//! same dimensions.
+//!
+//! @param cell Cell that contains the decoded sub arrays.
+//!
+//! @return @ref octave_value that contains the combined N-D array or @p cell
+//! if the sub arrays can't be combined.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! Cell cell (dim_vector (2, 1));
+//! cell(0) = NDArray (dim_vector (2, 1), 1);
+//! cell(1) = NDArray (dim_vector (3, 1), 2);
+//! octave_value array = combine_sub_arrays (cell);
+//! @endcode
+
+octave_value
+combine_sub_arrays (const Cell& cell)
+{
+  // Only arrays with sub arrays of booleans and numericals will return NDArray
+  bool is_bool_array = cell(0).islogical ();
+  dim_vector sub_array_dims = cell(0).dims ();
+  octave_idx_type sub_array_ndims = cell(0).ndims ();
+  octave_idx_type cell_numel = cell.numel ();
+  for (octave_idx_type i = 0; i < cell_numel; ++i)
+    {
+      // If one element is not numeric or boolean return the cell array as
+      // at least one of the sub arrays is either an array of: strings,
+      // objects or mixed array
+      if (! (cell(i).isnumeric () || cell(i).islogical ()))
+        return cell;
+      // If not the same dim of elements or dim = 0 return cell array
+      if (cell(i).dims () != sub_array_dims || sub_array_dims == dim_vector ())
+        return cell;
+      // If not numeric sub arrays only or bool
+      // sub arrays only return cell array
+      if(cell(i).islogical () != is_bool_array)
+        return cell;
+    }
+  // Calculate the dims of the output array
+  dim_vector array_dims;
+  array_dims.resize (sub_array_ndims + 1);
+  array_dims(0) = cell_numel;
+  for (auto i = 1; i < sub_array_ndims + 1; i++)
+    array_dims(i) = sub_array_dims(i-1);
+
+  if (is_bool_array)
+    return merge_sub_arrays<boolNDArray> (cell, array_dims);
+
+  // Sub arrays of different classes are merged into the class that holds
+  // all of them as the DOM decoder does for the @c NumericType option
+  std::string class_name = cell(0).class_name ();
+  for (octave_idx_type i = 1; i < cell_numel; ++i)
+    {
+      std::string sub_class_name = cell(i).class_name ();
+      if (sub_class_name != class_name)
+        class_name = ((class_name == "int32" || class_name == "int64")
+                      && (sub_class_name == "int32"
+                          || sub_class_name == "int64")) ? "int64" : "double";
+    }
+
+  if (class_name == "int32")
+    return merge_sub_arrays<int32NDArray> (cell, array_dims);
+  else if (class_name == "int64")
+    return merge_sub_arrays<int64NDArray> (cell, array_dims);
+  else if (class_name == "single")
+    return merge_sub_arrays<FloatNDArray> (cell, array_dims);
+  else
+    return merge_sub_arrays<NDArray> (cell, array_dims);
+}
+
+//! Builds the output of an array of strings for the @c Categorical option:
+//! a struct with the field @qcode{"categories"}, a cellstr of the distinct
+//! strings in the order of their first appearance, and the field
+//! @qcode{"codes"}, the uint32 index of each string in the categories.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! categorical_builder builder;
+//! builder.add ("a", 1, options);
+//! builder.add ("b", 1, options);
+//! builder.add ("a", 1, options);
+//! octave_value value = builder.finish ();
+//! @endcode
+
+class categorical_builder
+{
+public:
+
+  categorical_builder (void)
+    : m_codes (), m_index (), m_categories (), m_key ()
+  { }
+
+  //! Removes all the strings so that the builder can be reused.
+  void
+  clear (void)
+  {
+    m_codes.clear ();
+    m_index.clear ();
+    m_categories.clear ();
+  }
+
+  //! Appends a string to the array.
+  void
+  add (const char *str, std::size_t length, decode_options& options)
+  {
+    m_key.assign (str, length);
+    auto it = m_index.find (m_key);
+    if (it == m_index.end ())
+      {
+        it = m_index.emplace (m_key, m_categories.size () + 1).first;
+        m_categories.push_back (string_value (str, length, options));
+      }
+    m_codes.push_back (it->second);
+  }
+
+  //! The number of strings in the array.
+  std::size_t numel (void) const { return m_codes.size (); }
+
+  //! The decoded string at an index of the array.
+  const octave_value&
+  value (std::size_t index) const
+  {
+    return m_categories[m_codes[index] - 1];
+  }
+
+  //! Returns the codes and the categories of the strings.
+  octave_value
+  finish (void) const
+  {
+    uint32NDArray codes (dim_vector (m_codes.size (), 1));
+    std::copy (m_codes.begin (), m_codes.end (), codes.fortran_vec ());
+    Cell categories (dim_vector (m_categories.size (), 1));
+    for (std::size_t i = 0; i < m_categories.size (); ++i)
+      categories(i) = m_categories[i];
+
+    octave_scalar_map retval;
+    retval.assign ("codes", codes);
+    retval.assign ("categories", categories);
+    return retval;
+  }
+
+private:
+
+  std::vector<uint32_t> m_codes;
+
+  // Maps each distinct string to its code
+  std::unordered_map<std::string, uint32_t> m_index;
+
+  std::vector<octave_value> m_categories;
+
+  std::string m_key;
+};
+
+//! Decodes a JSON value that isn't an object or an array.
+//!
+//! @param val JSON value that is a boolean, a number, a string or null.
+//! @param options @c NumericType and @c InternStrings options with their
+//! values.
+//!
+//! @return @ref octave_value that contains the output of decoding @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! rapidjson::Document d;
+//! d.Parse ("\"foo\"");
+//! octave_value value = decode_scalar (d, options);
+//! @endcode
+
+octave_value
+decode_scalar (const rapidjson::Value& val, decode_options& options)
+{
+  if (val.IsBool ())
+    return val.GetBool ();
+  else if (val.IsNumber ())
+    return decode_number (val, options);
+  else if (val.IsString ())
+    return string_value (val.GetString (), val.GetStringLength (), options);
+  else if (val.IsNull ())
+    return NDArray (dim_vector (0,0));
+  else
+    error ("jsondecode.cc: Unidentified type.");
+}
+
+//! Reports that a JSON text is nested deeper than the @c MaxDepth option.
+//!
+//! @param options @c MaxDepth option with its value.
+
+void
+err_max_depth (const decode_options& options)
+{
+  error ("%s: The maximum nesting depth of %d is exceeded",
+         options.who.c_str (), options.max_depth);
+}
+
+//! Decodes JSON objects and arrays without recursion.  Each object or array
+//! that is being decoded has a frame on an explicit stack that holds its
+//! partial output and the position of the next member or element, so the
+//! nesting depth of a document is only limited by the @c MaxDepth option
+//! and not by the call stack.  The frames are kept in a pool and reused by
+//! the next container at the same depth.
+//!
+//! Objects are decoded into scalar structs, arrays of objects with the same
+//! field names into struct arrays with one column per field, arrays of
+//! numbers or booleans, and of sub arrays that can be combined, into N-D
+//! arrays, and the other arrays into Cells.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! rapidjson::Document d;
+//! d.Parse ("[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4}]");
+//! dom_decoder decoder (options);
+//! octave_value value = decoder.decode (d);
+//! @endcode
+
+class dom_decoder
+{
+public:
+
+  dom_decoder (decode_options& options)
+    : m_options (options), m_frames (), m_categories (), m_depth (0)
+  { }
+
+  //! Decodes a JSON value.
+  //!
+  //! @param val JSON value.
+  //!
+  //! @return @ref octave_value that contains the output of decoding @p val.
+
+  octave_value
+  decode (const rapidjson::Value& val)
+  {
+    octave_value value;
+    if (! start (val, nullptr, value))
+      return value;
+
+    while (true)
+      {
+        // References to the frames stay valid when the pool grows
+        frame& top = m_frames[m_depth-1];
+        const rapidjson::Value *elem;
+        const array_info *info;
+        if (next (top, elem, info))
+          {
+            if (! start (*elem, info, value))
+              store (top, value);
+            continue;
+          }
+
+        value = finish (top);
+        if (--m_depth == 0)
+          return value;
+        store (m_frames[m_depth-1], value);
+      }
+  }
+
+private:
+
+  //! The kind of the output of an object or array that is being decoded.
+  enum frame_kind
+  {
+    object_frame,
+    struct_array_frame,
+    cell_frame
+  };
+
+  //! The partial output of an object or array and the position of its next
+  //! member or element.
+  struct frame
+  {
+    frame_kind kind;
+    const rapidjson::Value *val;
+
+    //! The summary of an array that isn't a sub array of another array.
+    array_info own_info;
+
+    //! The summary of the array, own_info or a summary found with the
+    //! summary of the parent array.
+    const array_info *info;
+
+    //! The number of the elements or members that are started.
+    octave_idx_type index;
+
+    //! The next sub array summary in info->children.
+    std::size_t child;
+
+    //! The object that is being decoded, val or an element of val for
+    //! struct arrays.
+    const rapidjson::Value *object;
+
+    //! The next member of object.
+    rapidjson::Value::ConstMemberIterator member;
+
+    //! The field of each member of object for struct arrays.
+    const std::vector<octave_idx_type> *fields;
+
+    //! The field of the member whose value is being decoded.
+    octave_idx_type field;
+
+    std::vector<std::string> field_names;
+    std::vector<octave_idx_type> member_fields;
+    std::vector<std::string> other_names;
+    std::vector<octave_idx_type> other_fields;
+    std::vector<Cell> columns;
+    std::vector<octave_value> values;
+    Cell cell;
+  };
+
+  //! Returns the frame at the next depth without pushing it.
+  frame&
+  next_frame (void)
+  {
+    if (m_depth == m_frames.size ())
+      m_frames.emplace_back ();
+    return m_frames[m_depth];
+  }
+
+  //! Starts decoding a JSON value.  Returns false if the value is decoded
+  //! into @p value and true if a frame is pushed for it.
+  bool
+  start (const rapidjson::Value& val, const array_info *info,
+         octave_value& value)
+  {
+    if (! val.IsObject () && ! val.IsArray ())
+      {
+        value = decode_scalar (val, m_options);
+        return false;
+      }
+
+    if (m_depth >= static_cast<std::size_t> (m_options.max_depth))
+      err_max_depth (m_options);
+
+    frame& f = next_frame ();
+    f.val = &val;
+    if (val.IsObject ())
+      {
+        // The fields are found in one pass, duplicate keys overwrite the
+        // value of their field
+        f.kind = object_frame;
+        object_layout (val, m_options, f.field_names, f.member_fields);
+        f.values.assign (f.field_names.size (), octave_value ());
+        f.index = 0;
+        f.object = &val;
+        f.member = val.MemberBegin ();
+        m_depth++;
+        return true;
+      }
+
+    if (! info)
+      {
+        phase_timer timer (m_options.stats, &decode_stats::classify_time);
+        classify_array (val, f.own_info);
+        info = &f.own_info;
+      }
+    if (m_depth + info->depth > static_cast<std::size_t> (m_options.max_depth))
+      err_max_depth (m_options);
+
+    switch (info->kind)
+      {
+      case array_info::empty:
+        value = NDArray (dim_vector (0,0));
+        return false;
+      case array_info::numeric:
+      case array_info::boolean:
+        if (m_options.stats)
+          m_options.stats->nd_arrays++;
+        value = decode_nd_array (val, *info, m_options);
+        return false;
+      case array_info::array:
+        // Arrays of numbers or booleans are written directly into the
+        // output array without decoding the sub arrays first
+        if (info->is_nd)
+          {
+            if (m_options.stats)
+              m_options.stats->nd_arrays++;
+            value = decode_nd_array (val, *info, m_options);
+            return false;
+          }
+        break;
+      case array_info::string:
+        if (m_options.categorical)
+          {
+            m_categories.clear ();
+            for (const auto& elem : val.GetArray ())
+              m_categories.add (elem.GetString (), elem.GetStringLength (),
+                                m_options);
+            value = m_categories.finish ();
+            return false;
+          }
+        break;
+      default:
+        break;
+      }
+
+    f.kind = cell_frame;
+    f.info = info;
+    f.index = 0;
+    f.child = 0;
+    if (info->kind == array_info::object && same_layout (f))
+      {
+        // Write the values of each object directly into the columns of
+        // the fields
+        f.kind = struct_array_frame;
+        f.columns.assign (f.field_names.size (),
+                          Cell (dim_vector (val.Size (), 1)));
+        f.object = nullptr;
+        if (m_options.stats)
+          m_options.stats->struct_arrays++;
+      }
+    else
+      {
+        f.cell = Cell (dim_vector (val.Size (), 1));
+        if (m_options.stats)
+          m_options.stats->cell_arrays++;
+      }
+    m_depth++;
+    return true;
+  }
+
+  //! Checks if all the objects of an array are decoded into the same
+  //! field names, which are stored in the frame of the array.
+  bool
+  same_layout (frame& f)
+  {
+    // Find the layout of the fields once from the first object
+    const rapidjson::Value& first = (*f.val)[0];
+    object_layout (first, m_options, f.field_names, f.member_fields);
+
+    // Objects with the same keys in the same order have the same layout.
+    // Otherwise, compare the field names after calling makeValidName.
+    for (const auto& elem : f.val->GetArray ())
+      if (! same_keys (first, elem))
+        {
+          object_layout (elem, m_options, f.other_names, f.other_fields);
+          if (f.other_names != f.field_names)
+            return false;
+        }
+    return true;
+  }
+
+  //! Finds the next member or element of a frame.  Returns false if all of
+  //! them are decoded.
+  bool
+  next (frame& f, const rapidjson::Value *& elem, const array_info *& info)
+  {
+    info = nullptr;
+    switch (f.kind)
+      {
+      case object_frame:
+        if (f.member == f.object->MemberEnd ())
+          return false;
+        f.field = f.member_fields[f.index++];
+        elem = &f.member->value;
+        ++f.member;
+        return true;
+
+      case struct_array_frame:
+        while (! f.object || f.member == f.object->MemberEnd ())
+          {
+            if (f.index == f.val->Size ())
+              return false;
+            const rapidjson::Value& first = (*f.val)[0];
+            f.object = &(*f.val)[f.index++];
+            f.member = f.object->MemberBegin ();
+            f.field = 0;
+            f.fields = &f.member_fields;
+            if (! same_keys (first, *f.object))
+              {
+                object_layout (*f.object, m_options, f.other_names,
+                               f.other_fields);
+                f.fields = &f.other_fields;
+              }
+          }
+        elem = &f.member->value;
+        ++f.member;
+        return true;
+
+      default:
+        if (f.index == f.val->Size ())
+          return false;
+        elem = &(*f.val)[f.index++];
+        if (elem->IsArray ())
+          info = &f.info->children[f.child++];
+        return true;
+      }
+  }
+
+  //! Stores the output of the current member or element of a frame.
+  void
+  store (frame& f, const octave_value& value)
+  {
+    switch (f.kind)
+      {
+      case object_frame:
+        f.values[f.field] = value;
+        break;
+      case struct_array_frame:
+        f.columns[(*f.fields)[f.field++]](f.index - 1) = value;
+        break;
+      default:
+        f.cell(f.index - 1) = value;
+        break;
+      }
+  }
+
+  //! Returns the output of a frame whose members or elements are decoded.
+  octave_value
+  finish (frame& f)
+  {
+    switch (f.kind)
+      {
+      // The output is released from the frame, which is reused
+      case object_frame:
+        {
+          octave_value retval (make_scalar_map (f.field_names, f.values));
+          f.values.clear ();
+          return retval;
+        }
+      case struct_array_frame:
+        {
+          octave_map struct_array;
+          for (std::size_t i = 0; i < f.field_names.size (); ++i)
+            struct_array.assign (f.field_names[i], f.columns[i]);
+          f.columns.clear ();
+          return octave_value (struct_array);
+        }
+      default:
+        {
+          octave_value retval (f.cell);
+          f.cell = Cell ();
+          return retval;
+        }
+      }
+  }
+
+  decode_options& m_options;
+
+  //! The frames of the objects and arrays that are being decoded, the
+  //! innermost at m_depth - 1.
+  std::deque<frame> m_frames;
+
+  //! Reused for every array of strings with the @c Categorical option.
+  categorical_builder m_categories;
+
+  std::size_t m_depth;
+};
+
+//! Decodes any JSON value. This function only serves as an interface
+//! by choosing which function to call from the previous functions.
+//!
+//! @param val JSON value.
+//! @param options @c ReplacementStyle, @c Prefix, @c NumericType and
+//! @c MaxDepth options with their values.
+//!
+//! @return @ref octave_value that contains the output of decoding @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! rapidjson::Document d;
+//! d.Parse ("[{\"a\":1,\"b\":2},{\"b\":3,\"a\":4}]");
+//! octave_value value = decode (d, options);
+//! @endcode
+
+octave_value
+decode (const rapidjson::Value& val, decode_options& options)
+{
+  if (! val.IsObject () && ! val.IsArray ())
+    return decode_scalar (val, options);
+
+  dom_decoder decoder (options);
+  return decoder.decode (val);
+}
+
+//! Converts a token of a path into the index of an array element.  As in
+//! JSON Pointer, indices are decimal numbers without leading zeros.
+//!
+//! @param token A token of a path of the @c Select option.
+//!
+//! @return The index or -1 if @p token isn't an index.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_idx_type index = array_index ("12");
+//! @endcode
+
+octave_idx_type
+array_index (const std::string& token)
+{
+  if (token.empty () || token.size () > 15
+      || (token[0] == '0' && token.size () > 1))
+    return -1;
+  octave_idx_type index = 0;
+  for (char c : token)
+    {
+      if (! std::isdigit (static_cast<unsigned char> (c)))
+        return -1;
+      index = 10 * index + (c - '0');
+    }
+  return index;
+}
+
+//! Collects the values selected by the @c Select option into the output of
+//! the decoder, a value for a path or a Cell for a cellstr of paths.
+//!
+//! @param values The decoded values in the order of the paths.
+//! @param found @c bool for each path that indicates if its value exists.
+//! @param options @c Select option with its value.
+//!
+//! @return @ref octave_value that contains the selected values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! options.select_paths = "/a";
+//! options.select.push_back (std::vector<std::string> (1, "a"));
+//! octave_value value = selected_values (std::vector<octave_value> (1, 1.0),
+//!                                       std::vector<bool> (1, true), options);
+//! @endcode
+
+octave_value
+selected_values (const std::vector<octave_value>& values,
+                 const std::vector<bool>& found, const decode_options& options)
+{
+  bool is_cell = options.select_paths.iscell ();
+  for (std::size_t i = 0; i < found.size (); ++i)
+    if (! found[i])
+      {
+        std::string path = (is_cell ? options.select_paths.cell_value ()(i)
+                                    : options.select_paths).string_value ();
+        error ("%s: No value at path \'%s\'", options.who.c_str (),
+               path.c_str ());
+      }
+
+  if (! is_cell)
+    return values[0];
+
+  Cell retval (options.select_paths.dims ());
+  for (std::size_t i = 0; i < values.size (); ++i)
+    retval(i) = values[i];
+  return retval;
+}
+
+//! The types of the fields of a schema compiled by jsonschema.
+
+enum schema_type
+{
+  double_field,
+  single_field,
+  int32_field,
+  int64_field,
+  logical_field,
+  char_field,
+  cellstr_field,
+  any_field,
+  struct_field
+};
+
+//! A field of a schema: the JSON key, the name of the output field, its
+//! type and the schema of its objects for the @c struct_field type.
+
+struct schema_field
+{
+  std::string key;
+
+  std::string name;
+
+  schema_type type;
+
+  std::shared_ptr<const json_schema> fields;
+};
+
+//! The fields of the JSON objects that are decoded with a schema.  The keys
+//! are matched as they are, without @ref make_valid_name.
+
+struct json_schema
+{
+  std::vector<schema_field> fields;
+
+  //! The index in @c fields of each key.
+  std::unordered_map<std::string, std::size_t> index;
+};
+
+//! The columns that the values of the fields of a schema are written into.
+//! Each column is allocated once for all the records with the class of its
+//! field, so the values are written without checking their types first.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! json_schema schema;
+//! schema.fields.push_back ({"a", "a", double_field, nullptr});
+//! schema.index["a"] = 0;
+//! rapidjson::Document d;
+//! d.Parse ("{\"a\": 1}");
+//! schema_columns columns (schema, 1);
+//! columns.fill (d, 0, options);
+//! octave_scalar_map map = columns.finish (true);
+//! @endcode
+
+class schema_columns
+{
+public:
+
+  schema_columns (const json_schema& schema, octave_idx_type numel)
+    : m_schema (schema), m_columns (schema.fields.size ()),
+      m_seen (schema.fields.size ())
+  {
+    dim_vector dims (numel, 1);
+    for (std::size_t k = 0; k < m_columns.size (); ++k)
+      {
+        column& col = m_columns[k];
+        switch (schema.fields[k].type)
+          {
+          case double_field:
+            col.doubles = NDArray (dims);
+            break;
+          case single_field:
+            col.singles = FloatNDArray (dims);
+            break;
+          case int32_field:
+            col.int32s = int32NDArray (dims);
+            break;
+          case int64_field:
+            col.int64s = int64NDArray (dims);
+            break;
+          case logical_field:
+            col.logicals = boolNDArray (dims);
+            break;
+          case struct_field:
+            col.fields.reset (new schema_columns (*schema.fields[k].fields,
+                                                  numel));
+            break;
+          default:
+            col.cells = Cell (dims);
+            break;
+          }
+      }
+  }
+
+  //! Writes the values of a JSON object into a row of the columns.
+  void fill (const rapidjson::Value& val, octave_idx_type row,
+             decode_options& options, const std::string& path = "")
+  {
+    if (! val.IsObject ())
+      error ("%s: Schema mismatch in record %ld: %s must be an object",
+             options.who.c_str (), static_cast<long> (row + 1),
+             path.empty () ? "the record" : ("field '" + path + "'").c_str ());
+
+    std::fill (m_seen.begin (), m_seen.end (), false);
+    std::size_t k = 0;
+    for (const auto& pair : val.GetObject ())
+      {
+        // The keys are usually in the order of the schema
+        std::size_t field = k++;
+        const char *key = pair.name.GetString ();
+        std::size_t length = pair.name.GetStringLength ();
+        if (field >= m_columns.size ()
+            || m_schema.fields[field].key.compare (0, std::string::npos,
+                                                   key, length) != 0)
+          {
+            auto it = m_schema.index.find (std::string (key, length));
+            if (it == m_schema.index.end ())
+              error ("%s: Schema mismatch in record %ld: unknown field '%s%s'",
+                     options.who.c_str (), static_cast<long> (row + 1),
+                     path.empty () ? "" : (path + ".").c_str (),
+                     std::string (key, length).c_str ());
+            field = it->second;
+          }
+        m_seen[field] = true;
+        fill_value (pair.value, field, row, options, path);
+      }
+
+    for (std::size_t field = 0; field < m_seen.size (); ++field)
+      if (! m_seen[field])
+        error ("%s: Schema mismatch in record %ld: missing field '%s%s'",
+               options.who.c_str (), static_cast<long> (row + 1),
+               path.empty () ? "" : (path + ".").c_str (),
+               m_schema.fields[field].key.c_str ());
+  }
+
+  //! Returns the columns as the fields of a scalar struct, or the values of
+  //! the only row if the decoded value is a single object.
+  octave_scalar_map finish (bool is_single)
+  {
+    octave_scalar_map retval;
+    for (std::size_t k = 0; k < m_columns.size (); ++k)
+      {
+        column& col = m_columns[k];
+        octave_value value;
+        switch (m_schema.fields[k].type)
+          {
+          case double_field:
+            value = col.doubles;
+            break;
+          case single_field:
+            value = col.singles;
+            break;
+          case int32_field:
+            value = col.int32s;
+            break;
+          case int64_field:
+            value = col.int64s;
+            break;
+          case logical_field:
+            value = col.logicals;
+            break;
+          case struct_field:
+            value = col.fields->finish (is_single);
+            break;
+          default:
+            value = is_single ? col.cells(0) : octave_value (col.cells);
+            break;
+          }
+        retval.assign (m_schema.fields[k].name, value);
+      }
+    return retval;
+  }
+
+private:
+
+  struct column
+  {
+    NDArray doubles;
+    FloatNDArray singles;
+    int32NDArray int32s;
+    int64NDArray int64s;
+    boolNDArray logicals;
+    Cell cells;
+    std::unique_ptr<schema_columns> fields;
+  };
+
+  void fill_value (const rapidjson::Value& val, std::size_t field,
+                   octave_idx_type row, decode_options& options,
+                   const std::string& path)
+  {
+    const schema_field& f = m_schema.fields[field];
+    column& col = m_columns[field];
+    bool ok = true;
+    switch (f.type)
+      {
+      case double_field:
+        ok = val.IsNumber () || val.IsNull ();
+        if (ok)
+          col.doubles.xelem (row) = element_value<double> (val);
+        break;
+      case single_field:
+        ok = val.IsNumber () || val.IsNull ();
+        if (ok)
+          col.singles.xelem (row) = element_value<float> (val);
+        break;
+      case int32_field:
+        ok = val.IsInt ();
+        if (ok)
+          col.int32s.xelem (row) = element_value<octave_int32> (val);
+        break;
+      case int64_field:
+        ok = val.IsInt64 ();
+        if (ok)
+          col.int64s.xelem (row) = element_value<octave_int64> (val);
+        break;
+      case logical_field:
+        ok = val.IsBool ();
+        if (ok)
+          col.logicals.xelem (row) = val.GetBool ();
+        break;
+      case char_field:
+        ok = val.IsString ();
+        if (ok)
+          col.cells.xelem (row) = string_value (val.GetString (),
+                                                val.GetStringLength (),
+                                                options);
+        break;
+      case cellstr_field:
+        {
+          ok = val.IsArray ();
+          for (const auto& elem : val.GetArray ())
+            ok = ok && elem.IsString ();
+          if (ok)
+            {
+              Cell cellstr (dim_vector (val.Size (), 1));
+              octave_idx_type i = 0;
+              for (const auto& elem : val.GetArray ())
+                cellstr(i++) = string_value (elem.GetString (),
+                                             elem.GetStringLength (),
+                                             options);
+              col.cells.xelem (row) = cellstr;
+            }
+        }
+        break;
+      case struct_field:
+        col.fields->fill (val, row, options,
+                          path.empty () ? f.key : path + "." + f.key);
+        break;
+      default:
+        col.cells.xelem (row) = decode (val, options);
+        break;
+      }
+
+    if (! ok)
+      error ("%s: Schema mismatch in record %ld: field '%s%s' must be %s",
+             options.who.c_str (), static_cast<long> (row + 1),
+             path.empty () ? "" : (path + ".").c_str (), f.key.c_str (),
+             schema_type_name (f.type));
+  }
+
+  static const char * schema_type_name (schema_type type)
+  {
+    static const char *names[] = {"double", "single", "int32", "int64",
+                                  "logical", "char", "cellstr", "any",
+                                  "struct"};
+    return names[type];
+  }
+
+  const json_schema& m_schema;
+
+  std::vector<column> m_columns;
+
+  std::vector<bool> m_seen;
+};
+
+//! Decodes a JSON object or an array of JSON objects with the schema of
+//! the @c Schema option.  An array is decoded into a scalar struct whose
+//! fields are the columns of the records.
+//!
+//! @param val JSON value.
+//! @param options @c Schema option with its value.
+//!
+//! @return @ref octave_value that contains the decoded records.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! octave_scalar_map spec;
+//! spec.assign ("id", "int64");
+//! options.schema = compile_schema (spec);
+//! rapidjson::Document d;
+//! d.Parse ("[{\"id\": 1}, {\"id\": 2}]");
+//! octave_value columns = decode_schema (d, options);
+//! @endcode
+
+octave_value
+decode_schema (const rapidjson::Value& val, decode_options& options)
+{
+  if (val.IsArray ())
+    {
+      schema_columns columns (*options.schema, val.Size ());
+      octave_idx_type row = 0;
+      for (const auto& elem : val.GetArray ())
+        columns.fill (elem, row++, options);
+      return columns.finish (false);
+    }
+
+  schema_columns columns (*options.schema, 1);
+  columns.fill (val, 0, options);
+  return columns.finish (true);
+}
+
+//! Decodes the root of a JSON text, or only the values at the paths of the
+//! @c Select option if it is set, with the schema of the @c Schema option
+//! if it is set.
+//!
+//! @param val The root of the JSON text.
+//! @param options Decoding options with their values.
+//!
+//! @return @ref octave_value that contains the output of decoding @p val.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! options.select_paths = "a.b";
+//! options.select.push_back (std::vector<std::string> ({"a", "b"}));
+//! rapidjson::Document d;
+//! d.Parse ("{\"a\": {\"b\": [1, 2]}, \"c\": 3}");
+//! octave_value value = decode_root (d, options);
+//! @endcode
+
+octave_value
+decode_root (const rapidjson::Value& val, decode_options& options)
+{
+  if (options.select.empty ())
+    return options.schema ? decode_schema (val, options)
+                          : decode (val, options);
+
+  std::vector<octave_value> values (options.select.size ());
+  std::vector<bool> found (options.select.size (), false);
+  for (std::size_t i = 0; i < options.select.size (); ++i)
+    {
+      const rapidjson::Value *elem = &val;
+      for (const auto& token : options.select[i])
+        {
+          const rapidjson::Value *next = nullptr;
+          if (elem->IsObject ())
+            {
+              // The last member wins if a key is repeated, as in decode
+              for (const auto& pair : elem->GetObject ())
+                if (pair.name.GetStringLength () == token.size ()
+                    && token.compare (0, token.size (), pair.name.GetString (),
+                                      pair.name.GetStringLength ()) == 0)
+                  next = &pair.value;
+            }
+          else if (elem->IsArray ())
+            {
+              octave_idx_type index = array_index (token);
+              if (index >= 0
+                  && static_cast<rapidjson::SizeType> (index) < elem->Size ())
+                next = &(*elem)[index];
+            }
+          elem = next;
+          if (! elem)
+            break;
+        }
+
+      if (elem)
+        {
+          values[i] = options.schema ? decode_schema (*elem, options)
+                                     : decode (*elem, options);
+          found[i] = true;
+        }
+    }
+
+  return selected_values (values, found, options);
+}
+
+//! Builds the Octave value of a JSON text from the events of RapidJSON's
+//! SAX reader without creating a DOM.  The type of a JSON array depends on
+//! the types of all of its elements, so every open array keeps its elements
+//! in typed buffers (numbers, booleans or scalar structs) until it is closed
+//! or an element of a different type promotes it to a mixed array.
+//! The output is identical to the output of @ref decode.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! decode_handler handler (options);
+//! rapidjson::Reader reader;
+//! rapidjson::StringStream ss ("[1, 2, null]");
+//! reader.Parse<rapidjson::kParseNanAndInfFlag> (ss, handler);
+//! octave_value value = handler.result ();
+//! @endcode
+
+class decode_handler
+  : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, decode_handler>
+{
+public:
+
+  decode_handler (decode_options& options)
+    : m_options (options),
+      m_keep_integers (options.numeric_type != "double"
+                       && options.numeric_type != "single"),
+      m_frames (), m_depth (0), m_depth_exceeded (false), m_result ()
+  { }
+
+  bool Null (void) { add_number (octave_NaN, 0, null_number); return true; }
+
+  bool Bool (bool b) { add_bool (b); return true; }
+
+  bool Int (int i) { add_number (i, i, int32_number); return true; }
+
+  bool Uint (unsigned u)
+  {
+    add_number (u, u, u <= std::numeric_limits<int32_t>::max ()
+                      ? int32_number : int64_number);
+    return true;
+  }
+
+  bool Int64 (int64_t i) { add_number (i, i, int64_number); return true; }
+
+  bool Uint64 (uint64_t u)
+  {
+    if (u <= static_cast<uint64_t> (std::numeric_limits<int64_t>::max ()))
+      add_number (u, u, int64_number);
+    else
+      add_number (u, 0, double_number);
+    return true;
+  }
+
+  bool Double (double d) { add_number (d, 0, double_number); return true; }
+
+  bool String (const char *str, rapidjson::SizeType length, bool)
+  {
+    add_string (str, length);
+    return true;
+  }
+
+  bool StartObject (void)
+  {
+    return push_frame (true);
+  }
+
+  bool Key (const char *str, rapidjson::SizeType length, bool)
+  {
+    // Duplicate keys overwrite the value of their field
+    frame& f = m_frames[m_depth-1];
+    const std::string& name = valid_name (str, length, m_options);
+    auto it = f.field_index.emplace (name, f.field_names.size ()).first;
+    if (it->second == f.field_names.size ())
+      {
+        f.field_names.push_back (name);
+        f.field_values.emplace_back ();
+      }
+    f.field = it->second;
+    return true;
+  }
+
+  bool EndObject (rapidjson::SizeType)
+  {
+    const frame& f = m_frames[m_depth-1];
+    octave_scalar_map map = make_scalar_map (f.field_names, f.field_values);
+    --m_depth;
+    add_object (map);
+    return true;
+  }
+
+  bool StartArray (void)
+  {
+    return push_frame (false);
+  }
+
+  bool EndArray (rapidjson::SizeType)
+  {
+    octave_value array = finish_array (m_frames[m_depth-1]);
+    --m_depth;
+    add_value (array, array_element);
+    return true;
+  }
+
+  //! Returns the decoded value after the whole text has been parsed.
+  octave_value result (void) const { return m_result; }
+
+  //! Checks if the parse was stopped by the @c MaxDepth option.
+  bool depth_exceeded (void) const { return m_depth_exceeded; }
+
+private:
+
+  //! The types of the elements collected in an open array so far.
+  enum element_type
+  {
+    no_element,
+    numeric_element,
+    boolean_element,
+    string_element,
+    object_element,
+    array_element,
+    mixed_element
+  };
+
+  //! The integer types that a number fits in.
+  enum number_kind
+  {
+    null_number,
+    double_number,
+    int64_number,
+    int32_number
+  };
+
+  //! State of an open JSON object or array.
+  struct frame
+  {
+    bool is_object;
+
+    // Members of an object, the fields in the order of their first key
+    std::unordered_map<std::string, std::size_t> field_index;
+    std::vector<std::string> field_names;
+    std::vector<octave_value> field_values;
+    std::size_t field;
+
+    // Elements of an array
+    element_type type;
+    std::vector<double> numbers;
+    std::vector<octave_idx_type> null_indices;
+    // Integer values and kinds of the numbers for the NumericType option
+    std::vector<int64_t> integers;
+    std::vector<number_kind> kinds;
+    bool is_int32;
+    bool is_int64;
+    std::vector<bool> booleans;
+    std::vector<octave_scalar_map> objects;
+    bool same_field_names;
+    // Strings of an array with the Categorical option
+    categorical_builder strings;
+    std::vector<octave_value> values;
+  };
+
+  // Frames are reused after their object or array is closed, so their
+  // buffers keep their capacity during the whole parse.  The parse is
+  // stopped if the @c MaxDepth option is exceeded.
+  bool push_frame (bool is_object)
+  {
+    if (m_depth >= static_cast<std::size_t> (m_options.max_depth))
+      {
+        m_depth_exceeded = true;
+        return false;
+      }
+    if (m_depth == m_frames.size ())
+      m_frames.emplace_back ();
+    frame& f = m_frames[m_depth++];
+    f.is_object = is_object;
+    f.field_index.clear ();
+    f.field_names.clear ();
+    f.field_values.clear ();
+    f.type = no_element;
+    f.numbers.clear ();
+    f.null_indices.clear ();
+    f.integers.clear ();
+    f.kinds.clear ();
+    f.is_int32 = true;
+    f.is_int64 = true;
+    f.booleans.clear ();
+    f.objects.clear ();
+    f.same_field_names = true;
+    f.strings.clear ();
+    f.values.clear ();
+    return true;
+  }
+
+  // Converts the typed buffers of an array into octave values when an
+  // element of a different type is added to it.
+  void promote_to_mixed (frame& f)
+  {
+    if (f.type == numeric_element)
+      {
+        auto null_index = f.null_indices.begin ();
+        for (std::size_t i = 0; i < f.numbers.size (); ++i)
+          if (null_index != f.null_indices.end ()
+              && *null_index == static_cast<octave_idx_type> (i))
+            {
+              f.values.push_back (NDArray (dim_vector (0,0)));
+              ++null_index;
+            }
+          else if (m_keep_integers)
+            f.values.push_back (number_value (f.numbers[i], f.integers[i],
+                                              f.kinds[i]));
+          else
+            f.values.push_back (number_value (f.numbers[i], 0,
+                                              double_number));
+      }
+    else if (f.type == boolean_element)
+      for (bool b : f.booleans)
+        f.values.push_back (b);
+    else if (f.type == object_element)
+      for (const auto& map : f.objects)
+        f.values.push_back (map);
+    else if (f.type == string_element && m_options.categorical)
+      for (std::size_t i = 0; i < f.strings.numel (); ++i)
+        f.values.push_back (f.strings.value (i));
+    f.type = mixed_element;
+  }
+
+  octave_value number_value (double value, int64_t integer, number_kind kind)
+  {
+    if (kind == null_number)
+      return NDArray (dim_vector (0,0));
+    else
+      return make_number (value, integer, kind == int32_number,
+                          kind >= int64_number, m_options);
+  }
+
+  void add_number (double value, int64_t integer, number_kind kind)
+  {
+    if (m_depth == 0 || m_frames[m_depth-1].is_object)
+      add_value (number_value (value, integer, kind), mixed_element);
+    else
+      {
+        frame& f = m_frames[m_depth-1];
+        if (f.type == no_element)
+          f.type = numeric_element;
+        if (f.type == numeric_element)
+          {
+            if (kind == null_number)
+              f.null_indices.push_back (f.numbers.size ());
+            f.numbers.push_back (value);
+            f.is_int32 = f.is_int32 && kind == int32_number;
+            f.is_int64 = f.is_int64 && kind >= int64_number;
+            if (m_keep_integers)
+              {
+                f.integers.push_back (integer);
+                f.kinds.push_back (kind);
+              }
+          }
+        else
+          {
+            if (f.type != mixed_element)
+              promote_to_mixed (f);
+            f.values.push_back (number_value (value, integer, kind));
+          }
+      }
+  }
+
+  void add_bool (bool value)
+  {
+    if (m_depth == 0 || m_frames[m_depth-1].is_object)
+      add_value (value, mixed_element);
+    else
+      {
+        frame& f = m_frames[m_depth-1];
+        if (f.type == no_element)
+          f.type = boolean_element;
+        if (f.type == boolean_element)
+          f.booleans.push_back (value);
+        else
+          {
+            if (f.type != mixed_element)
+              promote_to_mixed (f);
+            f.values.push_back (value);
+          }
+      }
+  }
+
+  void add_object (const octave_scalar_map& map)
+  {
+    if (m_depth == 0 || m_frames[m_depth-1].is_object)
+      add_value (map, mixed_element);
+    else
+      {
+        frame& f = m_frames[m_depth-1];
+        if (f.type == no_element)
+          f.type = object_element;
+        if (f.type == object_element)
+          {
+            // Track if all the objects have the same field names
+            if (f.same_field_names && ! f.objects.empty ()
+                && ! equals (f.objects[0].fieldnames (), map.fieldnames ()))
+              f.same_field_names = false;
+            f.objects.push_back (map);
+          }
+        else
+          {
+            if (f.type != mixed_element)
+              promote_to_mixed (f);
+            f.values.push_back (map);
+          }
+      }
+  }
+
+  void add_string (const char *str, std::size_t length)
+  {
+    if (m_depth == 0 || m_frames[m_depth-1].is_object
+        || ! m_options.categorical)
+      add_value (string_value (str, length, m_options), string_element);
+    else
+      {
+        frame& f = m_frames[m_depth-1];
+        if (f.type == no_element)
+          f.type = string_element;
+        if (f.type == string_element)
+          f.strings.add (str, length, m_options);
+        else
+          {
+            if (f.type != mixed_element)
+              promote_to_mixed (f);
+            f.values.push_back (string_value (str, length, m_options));
+          }
+      }
+  }
+
+  // Adds an array or a value that is not an array element
+  void add_value (const octave_value& value, element_type type)
+  {
+    if (m_depth == 0)
+      m_result = value;
+    else if (m_frames[m_depth-1].is_object)
+      {
+        frame& f = m_frames[m_depth-1];
+        f.field_values[f.field] = value;
+      }
+    else
+      {
+        frame& f = m_frames[m_depth-1];
+        if (f.type == no_element)
+          f.type = type;
+        else if (f.type != type && f.type != mixed_element)
+          promote_to_mixed (f);
+        f.values.push_back (value);
+      }
+  }
+
+  // Creates the Octave value of an array when it is closed
+  octave_value finish_array (frame& f)
+  {
+    if (m_options.stats)
+      count_array (f, *m_options.stats);
+
+    switch (f.type)
+      {
+      case no_element:
+        return NDArray (dim_vector (0,0));
+
+      case numeric_element:
+        {
+          dim_vector dims (f.numbers.size (), 1);
+          switch (output_class (f.is_int32, f.is_int64, m_options))
+            {
+            case int32_class:
+              {
+                int32NDArray array (dims);
+                std::copy (f.integers.begin (), f.integers.end (),
+                           array.fortran_vec ());
+                return array;
+              }
+            case int64_class:
+              {
+                int64NDArray array (dims);
+                std::copy (f.integers.begin (), f.integers.end (),
+                           array.fortran_vec ());
+                return array;
+              }
+            case single_class:
+              {
+                FloatNDArray array (dims);
+                std::copy (f.numbers.begin (), f.numbers.end (),
+                           array.fortran_vec ());
+                return array;
+              }
+            default:
+              {
+                NDArray array (dims);
+                std::copy (f.numbers.begin (), f.numbers.end (),
+                           array.fortran_vec ());
+                return array;
+              }
+            }
+        }
+
+      case boolean_element:
+        {
+          boolNDArray array (dim_vector (f.booleans.size (), 1));
+          std::copy (f.booleans.begin (), f.booleans.end (),
+                     array.fortran_vec ());
+          return array;
+        }
+
+      case object_element:
+        {
+          octave_idx_type numel = f.objects.size ();
+          if (! f.same_field_names)
+            {
+              Cell cell (dim_vector (numel, 1));
+              for (octave_idx_type i = 0; i < numel; ++i)
+                cell(i) = f.objects[i];
+              return cell;
+            }
+
+          // Build the struct array column by column
+          octave_map struct_array;
+          string_vector field_names = f.objects[0].fieldnames ();
+          for (octave_idx_type k = 0; k < field_names.numel (); ++k)
+            {
+              Cell column (dim_vector (numel, 1));
+              for (octave_idx_type i = 0; i < numel; ++i)
+                column(i) = f.objects[i].contents (k);
+              struct_array.assign (field_names(k), column);
+            }
+          return struct_array;
+        }
+
+      case array_element:
+        return combine_sub_arrays (values_to_cell (f.values));
+
+      case string_element:
+        if (m_options.categorical)
+          return f.strings.finish ();
+        return values_to_cell (f.values);
+
+      default:
+        return values_to_cell (f.values);
+      }
+  }
+
+  //! Counts the decoder that @ref finish_array uses for an array.
+  void count_array (const frame& f, decode_stats& stats) const
+  {
+    switch (f.type)
+      {
+      case no_element:
+        break;
+      case numeric_element:
+      case boolean_element:
+        stats.nd_arrays++;
+        break;
+      case object_element:
+        if (f.same_field_names)
+          stats.struct_arrays++;
+        else
+          stats.cell_arrays++;
+        break;
+      case string_element:
+        if (! m_options.categorical)
+          stats.cell_arrays++;
+        break;
+      default:
+        stats.cell_arrays++;
+        break;
+      }
+  }
+
+  static Cell values_to_cell (const std::vector<octave_value>& values)
+  {
+    Cell cell (dim_vector (values.size (), 1));
+    for (std::size_t i = 0; i < values.size (); ++i)
+      cell(i) = values[i];
+    return cell;
+  }
+
+  decode_options& m_options;
+
+  // Only integer output classes need the integer values of the numbers
+  bool m_keep_integers;
+
+  std::vector<frame> m_frames;
+
+  std::size_t m_depth;
+
+  bool m_depth_exceeded;
+
+  octave_value m_result;
+};
+
+//! Filters the events of RapidJSON's SAX reader for the @c Select option.
+//! Only the events of the selected values are passed on, to a
+//! @ref decode_handler for each path, so the rest of the text is parsed
+//! without creating any value.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! options.select_paths = "a";
+//! options.select.push_back (std::vector<std::string> (1, "a"));
+//! select_handler handler (options);
+//! rapidjson::Reader reader;
+//! rapidjson::StringStream ss ("{\"a\": [1, 2], \"b\": [3, 4]}");
+//! reader.Parse<rapidjson::kParseNanAndInfFlag> (ss, handler);
+//! octave_value value = handler.result ();
+//! @endcode
+
+class select_handler
+  : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, select_handler>
+{
+public:
+
+  select_handler (decode_options& options)
+    : m_options (options), m_handlers (), m_indices (),
+      m_found (options.select.size (), false),
+      m_value_ok (options.select.size ()), m_is_object (), m_index (),
+      m_ok (), m_key (), m_depth_exceeded (false)
+  {
+    for (const auto& tokens : options.select)
+      {
+        m_handlers.emplace_back (options);
+        m_indices.emplace_back ();
+        for (const auto& token : tokens)
+          m_indices.back ().push_back (array_index (token));
+      }
+  }
+
+  bool Null (void)
+  {
+    return value ([] (decode_handler& h) { h.Null (); });
+  }
+
+  bool Bool (bool b)
+  {
+    return value ([b] (decode_handler& h) { h.Bool (b); });
+  }
+
+  bool Int (int i)
+  {
+    return value ([i] (decode_handler& h) { h.Int (i); });
+  }
+
+  bool Uint (unsigned u)
+  {
+    return value ([u] (decode_handler& h) { h.Uint (u); });
+  }
+
+  bool Int64 (int64_t i)
+  {
+    return value ([i] (decode_handler& h) { h.Int64 (i); });
+  }
+
+  bool Uint64 (uint64_t u)
+  {
+    return value ([u] (decode_handler& h) { h.Uint64 (u); });
+  }
+
+  bool Double (double d)
+  {
+    return value ([d] (decode_handler& h) { h.Double (d); });
+  }
+
+  bool String (const char *str, rapidjson::SizeType length, bool copy)
+  {
+    return value ([=] (decode_handler& h) { h.String (str, length, copy); });
+  }
+
+  bool StartObject (void)
+  {
+    return start ([] (decode_handler& h) { h.StartObject (); }, true);
+  }
+
+  bool Key (const char *str, rapidjson::SizeType length, bool copy)
+  {
+    std::size_t depth = m_is_object.size () - 1;
+    for (std::size_t s = 0; s < m_handlers.size (); ++s)
+      if (is_inside (s, depth))
+        m_handlers[s].Key (str, length, copy);
+    m_key.assign (str, length);
+    return true;
+  }
+
+  bool EndObject (rapidjson::SizeType count)
+  {
+    return end ([count] (decode_handler& h) { h.EndObject (count); });
+  }
+
+  bool StartArray (void)
+  {
+    return start ([] (decode_handler& h) { h.StartArray (); }, false);
+  }
+
+  bool EndArray (rapidjson::SizeType count)
+  {
+    return end ([count] (decode_handler& h) { h.EndArray (count); });
+  }
+
+  //! Returns the selected values after the whole text has been parsed.
+  octave_value result (void) const
+  {
+    std::vector<octave_value> values;
+    for (const auto& handler : m_handlers)
+      values.push_back (handler.result ());
+    return selected_values (values, m_found, m_options);
+  }
+
+  //! Checks if the parse was stopped by the @c MaxDepth option.
+  bool depth_exceeded (void) const { return m_depth_exceeded; }
+
+private:
+
+  // Checks if the open object or array at a depth is inside the value at
+  // a path
+  bool is_inside (std::size_t s, std::size_t depth) const
+  {
+    return m_ok[depth * m_handlers.size () + s]
+           && depth >= m_options.select[s].size ();
+  }
+
+  // Checks for each path if the value that starts at the current position
+  // matches the beginning of the path and if it is inside the selected value
+  template <typename Event>
+  void begin_value (Event event)
+  {
+    std::size_t depth = m_is_object.size ();
+    for (std::size_t s = 0; s < m_handlers.size (); ++s)
+      {
+        const std::vector<std::string>& tokens = m_options.select[s];
+        bool ok = true;
+        if (depth > 0)
+          {
+            std::size_t level = depth - 1;
+            ok = m_ok[level * m_handlers.size () + s]
+                 && (level >= tokens.size ()
+                     || (m_is_object[level] ? m_key == tokens[level]
+                                            : m_index[level]
+                                              == m_indices[s][level]));
+          }
+        m_value_ok[s] = ok;
+        if (ok && depth >= tokens.size ())
+          {
+            if (depth == tokens.size ())
+              m_found[s] = true;
+            event (m_handlers[s]);
+          }
+      }
+  }
+
+  // Moves to the next element of the enclosing array
+  void end_value (void)
+  {
+    if (! m_is_object.empty () && ! m_is_object.back ())
+      m_index.back ()++;
+  }
+
+  template <typename Event>
+  bool value (Event event)
+  {
+    begin_value (event);
+    end_value ();
+    return true;
+  }
+
+  template <typename Event>
+  bool start (Event event, bool is_object)
+  {
+    if (m_is_object.size () >= static_cast<std::size_t> (m_options.max_depth))
+      {
+        m_depth_exceeded = true;
+        return false;
+      }
+    begin_value (event);
+    m_is_object.push_back (is_object);
+    m_index.push_back (0);
+    m_ok.insert (m_ok.end (), m_value_ok.begin (), m_value_ok.end ());
+    return true;
+  }
+
+  template <typename Event>
+  bool end (Event event)
+  {
+    std::size_t depth = m_is_object.size () - 1;
+    for (std::size_t s = 0; s < m_handlers.size (); ++s)
+      if (is_inside (s, depth))
+        event (m_handlers[s]);
+    m_is_object.pop_back ();
+    m_index.pop_back ();
+    m_ok.resize (m_ok.size () - m_handlers.size ());
+    end_value ();
+    return true;
+  }
+
+  decode_options& m_options;
+
+  std::vector<decode_handler> m_handlers;
+
+  // The tokens of the paths as array indices
+  std::vector<std::vector<octave_idx_type>> m_indices;
+
+  std::vector<bool> m_found;
+
+  std::vector<char> m_value_ok;
+
+  // The open objects and arrays: their type, the index of the current
+  // element and if their position matches the beginning of each path
+  std::vector<bool> m_is_object;
+
+  std::vector<octave_idx_type> m_index;
+
+  std::vector<char> m_ok;
+
+  std::string m_key;
+
+  bool m_depth_exceeded;
+};
+
+//! Memory for parsing JSON texts that is kept between the calls of
+//! jsondecode on a thread instead of being allocated and freed by every
+//! call.  The values of the DOM and the parse stack of the document are
+//! allocated from two pools, each over a buffer that grows to the largest
+//! size that a text needed, up to @ref max_size, and is reset after each
+//! text.  The reader keeps the capacity of its own stack.  In steady state,
+//! parsing a text doesn't allocate memory at all.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! parser_arena::lease arena;
+//! rapidjson::StringStream ss ("[1, 2, null]");
+//! rapidjson::ParseResult result
+//!   = arena->parse<rapidjson::kParseNanAndInfFlag> (ss);
+//! const rapidjson::Value& val = arena->document ();
+//! arena->reset ();
+//! @endcode
+
+class parser_arena
+{
+public:
+
+  //! A document whose values and parse stack are allocated from pools.
+  typedef rapidjson::GenericDocument<rapidjson::UTF8<>,
+                                     rapidjson::MemoryPoolAllocator<>,
+                                     rapidjson::MemoryPoolAllocator<>>
+    document_type;
+
+  //! The initial size of the buffer of each pool.
+  static const std::size_t initial_size = 65536;
+
+  //! The maximum size of the buffer of each pool.  Texts that need more
+  //! memory allocate the rest and free it when the arena is reset.
+  static const std::size_t max_size = 16 << 20;
+
+  //! Gives the arena of the calling thread to one decoding, or a new arena
+  //! if it is already in use, e.g. by a call of jsondecode in a
+  //! @c BatchFcn callback.
+
+  class lease
+  {
+  public:
+
+    lease (void)
+      : m_temporary (), m_arena (&thread_arena ())
+    {
+      if (m_arena->m_busy)
+        {
+          m_temporary.reset (new parser_arena ());
+          m_arena = m_temporary.get ();
+        }
+      m_arena->m_busy = true;
+    }
+
+    lease (const lease&) = delete;
+
+    lease& operator = (const lease&) = delete;
+
+    ~lease (void)
+    {
+      m_arena->release ();
+      m_arena->m_busy = false;
+    }
+
+    parser_arena& operator * (void) const { return *m_arena; }
+
+    parser_arena * operator -> (void) const { return m_arena; }
+
+  private:
+
+    std::unique_ptr<parser_arena> m_temporary;
+
+    parser_arena *m_arena;
+  };
+
+  parser_arena (void)
+    : m_values (), m_stack (), m_document (), m_reader (), m_peak (0),
+      m_parses (0), m_busy (false)
+  {
+    rebuild (initial_size, initial_size);
+  }
+
+  parser_arena (const parser_arena&) = delete;
+
+  parser_arena& operator = (const parser_arena&) = delete;
+
+  //! Returns the arena of the calling thread.
+  static parser_arena&
+  thread_arena (void)
+  {
+    // The arenas are never destroyed, so no destructor of this oct-file is
+    // called at the exit of a thread after the oct-file is unloaded
+    static thread_local parser_arena *arena = nullptr;
+    if (! arena)
+      arena = new parser_arena ();
+    return *arena;
+  }
+
+  //! The document that the texts are parsed into.
+  document_type& document (void) { return *m_document; }
+
+  //! The reader for the SAX decoder.
+  rapidjson::Reader& reader (void) { return m_reader; }
+
+  //! Parses a JSON text into the document.
+  template <unsigned parse_flags, typename InputStream>
+  rapidjson::ParseResult
+  parse (InputStream& is)
+  {
+    rapidjson::ParseResult result;
+    auto generator = [&] (document_type& d)
+      {
+        result = m_reader.Parse<parse_flags> (is, d);
+        return ! result.IsError ();
+      };
+    m_document->Populate (generator);
+    m_parses++;
+    return result;
+  }
+
+  //! Frees the values of the last text.  If the text didn't fit in the
+  //! buffers, they are enlarged for the next texts.
+  //!
+  //! @param stats Counters that the memory used by the text is added to,
+  //! or null.
+  void
+  reset (decode_stats *stats = nullptr)
+  {
+    std::size_t values = m_values.allocator->Size ();
+    std::size_t stack = m_stack.allocator->Size ();
+    m_peak = std::max (m_peak, values + stack);
+    if (stats)
+      {
+        stats->arena_peak = std::max (stats->arena_peak, values + stack);
+        std::size_t spill_bytes = m_values.spill_bytes ()
+                                  + m_stack.spill_bytes ();
+        if (spill_bytes > 0)
+          {
+            stats->arena_spills++;
+            stats->arena_spill_bytes += spill_bytes;
+          }
+      }
+
+    std::size_t values_size = m_values.grown_size ();
+    std::size_t stack_size = m_stack.grown_size ();
+    if (values_size != m_values.buffer.size ()
+        || stack_size != m_stack.buffer.size ())
+      rebuild (values_size, stack_size);
+    else
+      release ();
+  }
+
+  //! Returns the sizes of the arena in bytes and the number of parses.
+  octave_scalar_map
+  report (void) const
+  {
+    octave_scalar_map retval;
+    retval.assign ("values", static_cast<double> (m_values.buffer.size ()));
+    retval.assign ("stack", static_cast<double> (m_stack.buffer.size ()));
+    retval.assign ("peak", static_cast<double> (m_peak));
+    retval.assign ("limit", static_cast<double> (max_size));
+    retval.assign ("parses", static_cast<double> (m_parses));
+    return retval;
+  }
+
+private:
+
+  //! A pool allocator over a buffer.
+  struct pool
+  {
+    std::vector<char> buffer;
+
+    std::unique_ptr<rapidjson::MemoryPoolAllocator<>> allocator;
+
+    //! The capacity of the allocator when nothing was allocated outside
+    //! the buffer.
+    std::size_t capacity;
+
+    void
+    rebuild (std::size_t size)
+    {
+      allocator.reset ();
+      std::vector<char> (size).swap (buffer);
+      allocator.reset (new rapidjson::MemoryPoolAllocator<> (buffer.data (),
+                                                             size));
+      capacity = allocator->Capacity ();
+    }
+
+    //! Checks if the last text allocated memory outside the buffer.
+    bool
+    spilled (void) const
+    {
+      return allocator->Capacity () != capacity;
+    }
+
+    //! Returns the bytes that the last text allocated outside the buffer.
+    std::size_t
+    spill_bytes (void) const
+    {
+      return allocator->Capacity () - capacity;
+    }
+
+    //! Returns the size of the buffer that the last text would have fit in.
+    std::size_t
+    grown_size (void) const
+    {
+      std::size_t size = buffer.size ();
+      if (! spilled ())
+        return size;
+
+      std::size_t used = allocator->Size ();
+      while (size < max_size && size - size / 8 < used)
+        size *= 2;
+      return size < max_size ? size : max_size;
+    }
+  };
+
+  // The document refers to the allocators, so it is created again with them
+  void
+  rebuild (std::size_t values_size, std::size_t stack_size)
+  {
+    m_document.reset ();
+    m_values.rebuild (values_size);
+    m_stack.rebuild (stack_size);
+    m_document.reset (new document_type (m_values.allocator.get (), 1024,
+                                         m_stack.allocator.get ()));
+  }
+
+  // Frees the values without enlarging the buffers
+  void
+  release (void)
+  {
+    m_document->SetNull ();
+    m_values.allocator->Clear ();
+    m_stack.allocator->Clear ();
+  }
+
+  pool m_values;
+
+  pool m_stack;
+
+  std::unique_ptr<document_type> m_document;
+
+  rapidjson::Reader m_reader;
+
+  std::size_t m_peak;
+
+  std::size_t m_parses;
+
+  bool m_busy;
+};
+
+//! Decodes a JSON text with RapidJSON's SAX reader.  No DOM is created,
+//! the values are built by @ref decode_handler while the text is parsed.
+//!
+//! @param is RapidJSON input stream of the JSON text.
+//! @param reader The reader of a @ref parser_arena.
+//! @param options Decoding options with their values.
+//!
+//! @return @ref octave_value that contains the output of decoding the text.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! parser_arena::lease arena;
+//! rapidjson::StringStream ss ("[1, 2, null]");
+//! octave_value value = sax_decode<rapidjson::kParseNanAndInfFlag> (
+//!                        ss, arena->reader (), options);
+//! @endcode
+
+template <unsigned parse_flags, typename InputStream>
+octave_value
+sax_decode (InputStream& is, rapidjson::Reader& reader,
+            decode_options& options)
+{
+  phase_timer timer (options.stats, &decode_stats::decode_time);
+  rapidjson::ParseResult result;
+  bool depth_exceeded;
+  octave_value retval;
+  if (options.select.empty ())
+    {
+      decode_handler handler (options);
+      result = reader.Parse<parse_flags> (is, handler);
+      depth_exceeded = handler.depth_exceeded ();
+      retval = handler.result ();
+    }
+  else
+    {
+      select_handler handler (options);
+      result = reader.Parse<parse_flags> (is, handler);
+      depth_exceeded = handler.depth_exceeded ();
+      if (! result.IsError ())
+        retval = handler.result ();
+    }
+
+  if (depth_exceeded)
+    err_max_depth (options);
+  else if (result.IsError ())
+    error("%s: Parse error at offset %u: %s\n", options.who.c_str (),
+          (unsigned) result.Offset (),
+          rapidjson::GetParseError_En (result.Code ()));
+  return retval;
+}
+
+//! Counts the values of a DOM for @ref decode_stats.
+//!
+//! @param val The root of the DOM.
+//!
+//! @return The number of values in @p val including itself.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::Document d;
+//! d.Parse ("{\"a\": [1, 2]}");
+//! std::size_t n = count_nodes (d);
+//! @endcode
+
+std::size_t
+count_nodes (const rapidjson::Value& val)
+{
+  std::size_t n = 0;
+  std::vector<const rapidjson::Value *> stack (1, &val);
+  while (! stack.empty ())
+    {
+      const rapidjson::Value *elem = stack.back ();
+      stack.pop_back ();
+      n++;
+      if (elem->IsObject ())
+        for (const auto& pair : elem->GetObject ())
+          stack.push_back (&pair.value);
+      else if (elem->IsArray ())
+        for (const auto& sub : elem->GetArray ())
+          stack.push_back (&sub);
+    }
+  return n;
+}
+
+//! Parses a JSON text into a DOM and decodes it.
+//!
+//! @param is RapidJSON input stream of the JSON text.
+//! @param arena The arena that the text is parsed into.
+//! @param options Decoding options with their values.
+//!
+//! @return @ref octave_value that contains the output of decoding the text.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! parser_arena::lease arena;
+//! rapidjson::StringStream ss ("[1, 2, null]");
+//! octave_value value = dom_decode<rapidjson::kParseNanAndInfFlag> (
+//!                        ss, *arena, options);
+//! @endcode
+
+template <unsigned parse_flags, typename InputStream>
+octave_value
+dom_decode (InputStream& is, parser_arena& arena, decode_options& options)
+{
+  // DOM is chosen by default instead of SAX as SAX publishes events to a
+  // handler that decides what to do depending on the event only. The output
+  // of a JSON array may be an array or a cell and that doesn't only depend on
+  // the event (startArray) but also on the types of the elements inside the
+  // array, so the SAX handler has to buffer every open array.
+  rapidjson::ParseResult result;
+  {
+    phase_timer timer (options.stats, &decode_stats::parse_time);
+    result = arena.parse<parse_flags> (is);
+  }
+
+  if (result.IsError ())
+    error("%s: Parse error at offset %u: %s\n", options.who.c_str (),
+          (unsigned) result.Offset (),
+          rapidjson::GetParseError_En (result.Code ()));
+  if (options.stats)
+    options.stats->dom_nodes += count_nodes (arena.document ());
+
+  octave_value retval;
+  {
+    phase_timer timer (options.stats, &decode_stats::decode_time);
+    retval = decode_root (arena.document (), options);
+  }
+  arena.reset (options.stats);
+  return retval;
+}
+
+//! Collects the decoded records of a JSON Lines text.  As long as all the
+//! records are objects with the same field names, their values are stored
+//! column by column and the batch is returned as a struct array like in
+//! @ref decode_object_array.  Otherwise, it is returned as a Cell.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! rapidjson::Document d;
+//! d.Parse ("{\"a\": 1}");
+//! record_batch batch;
+//! batch.add_object (d, options);
+//! octave_value value = batch.finish ();
+//! @endcode
+
+class record_batch
+{
+public:
+
+  record_batch (void)
+    : m_is_columnar (true), m_numel (0), m_raw_keys (), m_field_names (),
+      m_member_fields (), m_columns (), m_records ()
+  { }
+
+  octave_idx_type numel (void) const { return m_numel; }
+
+  //! Adds a record that is a JSON object.  Its values are decoded directly
+  //! into the columns if it has the same fields as the previous records.
+  void add_object (const rapidjson::Value& val, decode_options& options)
+  {
+    if (m_is_columnar && m_numel == 0)
+      {
+        object_layout (val, options, m_field_names, m_member_fields);
+        m_columns.resize (m_field_names.size ());
+        for (const auto& pair : val.GetObject ())
+          m_raw_keys.emplace_back (pair.name.GetString (),
+                                   pair.name.GetStringLength ());
+      }
+
+    if (m_is_columnar)
+      {
+        const std::vector<octave_idx_type> *fields = &m_member_fields;
+        if (! has_raw_keys (val))
+          {
+            object_layout (val, options, m_other_names, m_other_fields);
+            if (m_other_names != m_field_names)
+              to_cell ();
+            fields = &m_other_fields;
+          }
+
+        if (m_is_columnar)
+          {
+            for (auto& column : m_columns)
+              column.push_back (octave_value ());
+            octave_idx_type k = 0;
+            for (const auto& pair : val.GetObject ())
+              m_columns[(*fields)[k++]].back () = decode (pair.value, options);
+            m_numel++;
+            return;
+          }
+      }
+
+    m_records.push_back (decode (val, options));
+    m_numel++;
+  }
+
+  //! Adds a decoded record.
+  void add (const octave_value& value)
+  {
+    if (m_is_columnar && value.isstruct () && value.numel () == 1)
+      {
+        octave_scalar_map map = value.scalar_map_value ();
+        string_vector field_names = map.fieldnames ();
+        if (m_numel == 0)
+          {
+            m_field_names.clear ();
+            for (octave_idx_type k = 0; k < field_names.numel (); ++k)
+              m_field_names.push_back (field_names(k));
+            m_columns.resize (m_field_names.size ());
+          }
+
+        bool same_field_names
+          = (static_cast<std::size_t> (field_names.numel ())
+             == m_field_names.size ());
+        for (octave_idx_type k = 0; same_field_names
+                                    && k < field_names.numel (); ++k)
+          same_field_names = (field_names(k) == m_field_names[k]);
+
+        if (same_field_names)
+          {
+            for (std::size_t k = 0; k < m_columns.size (); ++k)
+              m_columns[k].push_back (map.contents (k));
+            m_numel++;
+            return;
+          }
+      }
+
+    if (m_is_columnar)
+      to_cell ();
+    m_records.push_back (value);
+    m_numel++;
+  }
+
+  //! Returns the decoded batch and starts a new one.
+  octave_value finish (void)
+  {
+    octave_value retval;
+    if (m_numel == 0)
+      retval = NDArray (dim_vector (0,0));
+    else if (m_is_columnar)
+      {
+        octave_map struct_array;
+        for (std::size_t k = 0; k < m_field_names.size (); ++k)
+          {
+            Cell column (dim_vector (m_numel, 1));
+            for (octave_idx_type i = 0; i < m_numel; ++i)
+              column(i) = m_columns[k][i];
+            struct_array.assign (m_field_names[k], column);
+          }
+        retval = struct_array;
+      }
+    else
+      {
+        Cell cell (dim_vector (m_numel, 1));
+        for (octave_idx_type i = 0; i < m_numel; ++i)
+          cell(i) = m_records[i];
+        retval = cell;
+      }
+
+    m_is_columnar = true;
+    m_numel = 0;
+    m_raw_keys.clear ();
+    m_field_names.clear ();
+    m_member_fields.clear ();
+    m_columns.clear ();
+    m_records.clear ();
+    return retval;
+  }
+
+private:
+
+  // Checks if an object has the same keys in the same order as the first
+  // record of the batch
+  bool has_raw_keys (const rapidjson::Value& val) const
+  {
+    if (val.MemberCount () != m_raw_keys.size ())
+      return false;
+    std::size_t k = 0;
+    for (const auto& pair : val.GetObject ())
+      {
+        const std::string& key = m_raw_keys[k++];
+        if (pair.name.GetStringLength () != key.size ()
+            || key.compare (0, key.size (), pair.name.GetString (),
+                            pair.name.GetStringLength ()) != 0)
+          return false;
+      }
+    return true;
+  }
+
+  // Converts the records stored column by column into scalar structs
+  void to_cell (void)
+  {
+    std::vector<octave_value> values (m_field_names.size ());
+    for (octave_idx_type i = 0; i < m_numel; ++i)
+      {
+        for (std::size_t k = 0; k < m_field_names.size (); ++k)
+          values[k] = m_columns[k][i];
+        m_records.push_back (make_scalar_map (m_field_names, values));
+      }
+    m_columns.clear ();
+    m_is_columnar = false;
+  }
+
+  bool m_is_columnar;
+
+  octave_idx_type m_numel;
+
+  std::vector<std::string> m_raw_keys;
+
+  std::vector<std::string> m_field_names;
+
+  std::vector<octave_idx_type> m_member_fields;
+
+  std::vector<std::string> m_other_names;
+
+  std::vector<octave_idx_type> m_other_fields;
+
+  std::vector<std::vector<octave_value>> m_columns;
+
+  std::vector<octave_value> m_records;
+};
+
+//! Skips the whitespace between two records of a JSON Lines text.
+//!
+//! @param is RapidJSON input stream of the JSON text.
+//!
+//! @return @c bool that indicates if there are more characters in @p is.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::StringStream ss ("\n\n");
+//! bool has_more = skip_whitespace (ss);
+//! @endcode
+
+template <typename InputStream>
+bool
+skip_whitespace (InputStream& is)
+{
+  char c = is.Peek ();
+  while (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+    {
+      is.Take ();
+      c = is.Peek ();
+    }
+  return c != '\0';
+}
+
+//! Skips the whitespace after a record of a JSON Lines text up to the end
+//! of its line.
+//!
+//! @param is RapidJSON input stream of the JSON text.
+//!
+//! @return @c bool that is false if another value follows the record on
+//! the same line.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! rapidjson::StringStream ss (" \r\n{}");
+//! bool at_end_of_line = skip_to_end_of_line (ss);
+//! @endcode
+
+template <typename InputStream>
+bool
+skip_to_end_of_line (InputStream& is)
+{
+  char c = is.Peek ();
+  while (c == ' ' || c == '\r' || c == '\t')
+    {
+      is.Take ();
+      c = is.Peek ();
+    }
+  return c == '\n' || c == '\0';
+}
+
+//! Decodes a JSON Lines text, i.e. a sequence of JSON texts separated by
+//! newlines.  The records are parsed one after another into the same
+//! arena, which is reset after each record, and collected by
+//! @ref record_batch.
+//!
+//! @param is RapidJSON input stream of the JSON Lines text.
+//! @param arena The arena that the records are parsed into.
+//! @param options Decoding options with their values.
+//!
+//! @return @ref octave_value that contains the decoded records, a Cell of
+//! batches if @c BatchSize is set or nothing if @c BatchFcn is set.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! parser_arena::lease arena;
+//! rapidjson::StringStream ss ("{\"a\": 1}\n{\"a\": 2}\n");
+//! octave_value value = decode_lines<rapidjson::kParseNanAndInfFlag> (
+//!                        ss, *arena, options);
+//! @endcode
+
+template <unsigned parse_flags, typename InputStream>
+octave_value
+decode_lines (InputStream& is, parser_arena& arena, decode_options& options)
+{
+  const unsigned flags = parse_flags | rapidjson::kParseStopWhenDoneFlag;
+  rapidjson::Reader& reader = arena.reader ();
+  decode_handler handler (options);
+
+  record_batch batch;
+  std::vector<octave_value> batches;
+  auto flush_batch = [&] (void)
+    {
+      if (options.batch_fcn.is_defined ())
+        octave::feval (options.batch_fcn, ovl (batch.finish ()), 0);
+      else
+        batches.push_back (batch.finish ());
+    };
+
+  while (skip_whitespace (is))
+    {
+      if (options.streaming && ! options.select.empty ())
+        batch.add (sax_decode<flags> (is, reader, options));
+      else if (options.streaming)
+        {
+          phase_timer timer (options.stats, &decode_stats::decode_time);
+          rapidjson::ParseResult result = reader.Parse<flags> (is, handler);
+          if (handler.depth_exceeded ())
+            err_max_depth (options);
+          else if (result.IsError ())
+            error("%s: Parse error at offset %u: %s\n", options.who.c_str (),
+                  (unsigned) result.Offset (),
+                  rapidjson::GetParseError_En (result.Code ()));
+          batch.add (handler.result ());
+        }
+      else
+        {
+          rapidjson::ParseResult result;
+          {
+            phase_timer timer (options.stats, &decode_stats::parse_time);
+            result = arena.parse<flags> (is);
+          }
+          if (result.IsError ())
+            error("%s: Parse error at offset %u: %s\n", options.who.c_str (),
+                  (unsigned) result.Offset (),
+                  rapidjson::GetParseError_En (result.Code ()));
+
+          // The document is created again when the arena grows, so it is
+          // looked up for every record
+          const parser_arena::document_type& d = arena.document ();
+          if (options.stats)
+            options.stats->dom_nodes += count_nodes (d);
+
+          phase_timer timer (options.stats, &decode_stats::decode_time);
+          if (d.IsObject () && options.select.empty () && ! options.schema)
+            batch.add_object (d, options);
+          else
+            batch.add (decode_root (d, options));
+          arena.reset (options.stats);
+        }
+
+      if (! skip_to_end_of_line (is))
+        error ("%s: Records must be separated by newlines at offset %u",
+               options.who.c_str (), (unsigned) is.Tell ());
+
+      if (batch.numel () == options.batch_size)
+        flush_batch ();
+    }
+
+  if (options.batch_size == 0)
+    return batch.finish ();
+
+  if (batch.numel () > 0)
+    flush_batch ();
+  if (options.batch_fcn.is_defined ())
+    return octave_value ();
+
+  Cell cell (dim_vector (batches.size (), 1));
+  for (std::size_t i = 0; i < batches.size (); ++i)
+    cell(i) = batches[i];
+  return cell;
+}
+
+//! The powers of ten that are exact doubles.
+
+static const double exact_powers_of_ten[] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+  1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//! Parses a JSON number with Clinger's fast path: integers of at most 19
+//! digits are converted to double once, and numbers with a fraction or an
+//! exponent are an exact significand of at most 2^53 multiplied or divided
+//! by an exact power of ten, which rounds correctly.  RapidJSON's parser
+//! computes these numbers the same way, so the values are bit-identical.
+//!
+//! @param p Pointer to the first character of the number, moved after it.
+//! @param end Pointer to the end of the text.
+//! @param value The value of the number.
+//!
+//! @return @c bool that is false if the text isn't a number or the number
+//! is outside of the fast path.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! const char *text = "-12.5e-3";
+//! double value;
+//! bool ok = parse_number (text, text + 8, value);
+//! @endcode
+
+bool
+parse_number (const char *& p, const char *end, double& value)
+{
+  bool minus = (p != end && *p == '-');
+  if (minus)
+    ++p;
+  if (p == end || *p < '0' || *p > '9')
+    return false;
+
+  uint64_t significand = 0;
+  int digits = 0;
+  int exponent = 0;
+  if (*p == '0')
+    ++p;
+  else
+    for (; p != end && *p >= '0' && *p <= '9'; ++p)
+      {
+        if (++digits > 19)
+          return false;
+        significand = significand * 10 + (*p - '0');
+      }
+
+  bool is_integer = true;
+  if (p != end && *p == '.')
+    {
+      is_integer = false;
+      if (++p == end || *p < '0' || *p > '9')
+        return false;
+      for (; p != end && *p >= '0' && *p <= '9'; ++p)
+        {
+          // Leading zeros of the fraction only move the exponent
+          if ((significand != 0 || *p != '0') && ++digits > 19)
+            return false;
+          significand = significand * 10 + (*p - '0');
+          exponent--;
+        }
+    }
+
+  if (p != end && (*p == 'e' || *p == 'E'))
+    {
+      is_integer = false;
+      bool exp_minus = false;
+      if (++p != end && (*p == '+' || *p == '-'))
+        exp_minus = (*p++ == '-');
+      if (p == end || *p < '0' || *p > '9')
+        return false;
+      int exp = 0;
+      for (; p != end && *p >= '0' && *p <= '9'; ++p)
+        {
+          if (exp > 1000)
+            return false;
+          exp = exp * 10 + (*p - '0');
+        }
+      exponent += exp_minus ? -exp : exp;
+    }
+
+  if (is_integer)
+    {
+      // Like RapidJSON, -0 is the integer 0 and only numbers below -2^63
+      // are parsed as doubles
+      if (minus && significand > (uint64_t (1) << 63))
+        return false;
+      value = static_cast<double> (significand);
+      if (minus && significand != 0)
+        value = -value;
+      return true;
+    }
+
+  if (significand > (uint64_t (1) << 53) || exponent < -22 || exponent > 22)
+    return false;
+  value = static_cast<double> (significand);
+  if (exponent >= 0)
+    value *= exact_powers_of_ten[exponent];
+  else
+    value /= exact_powers_of_ten[-exponent];
+  if (minus)
+    value = -value;
+  return true;
+}
+
+//! Parses a flat JSON array of numbers and nulls into a buffer that grows
+//! with the elements, so a text that isn't such an array is given up at its
+//! first other token without allocating memory for its whole length.
+//!
+//! @param p Pointer to the first character after the opening bracket.
+//! @param end Pointer to the end of the text.
+//! @param values The buffer that the elements are appended to.
+//!
+//! @return @c bool that is false if the text isn't such an array or a
+//! number is outside of the fast path of @ref parse_number.
+
+template <typename T> bool
+parse_numeric_array (const char *p, const char *end, std::vector<T>& values)
+{
+  auto skip = [&p, end] (void)
+    {
+      while (p != end && (*p == ' ' || *p == '\n' || *p == '\r'
+                          || *p == '\t'))
+        ++p;
+    };
+
+  const T nan = element_value<T> (rapidjson::Value ());
+  while (true)
+    {
+      skip ();
+      double value;
+      if (end - p >= 4 && std::equal (p, p + 4, "null"))
+        {
+          values.push_back (nan);
+          p += 4;
+        }
+      else if (parse_number (p, end, value))
+        values.push_back (static_cast<T> (value));
+      else
+        return false;
+
+      skip ();
+      if (p == end)
+        return false;
+      else if (*p == ']')
+        break;
+      else if (*p != ',')
+        return false;
+      ++p;
+    }
+
+  ++p;
+  skip ();
+  return p == end;
+}
+
+//! Decodes a JSON text that is a flat array of numbers and nulls, the
+//! common layout of large numeric payloads, without building a DOM.  The
+//! numbers are parsed by @ref parse_number and the output array is only
+//! allocated once the whole text is parsed.  Any other text, or a number
+//! outside of the fast path, is left to the generic decoders, so the output
+//! doesn't change.
+//!
+//! @param text Pointer to the JSON text.
+//! @param length The number of characters in @p text.
+//! @param options Decoding options with their values.
+//! @param retval The decoded array.
+//!
+//! @return @c bool that indicates if the text was decoded.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! octave_value value;
+//! bool ok = decode_numeric_text ("[1.5, 2, null]", 14, options, value);
+//! @endcode
+
+bool
+decode_numeric_text (const char *text, std::size_t length,
+                     const decode_options& options, octave_value& retval)
+{
+  if (options.json_lines || ! options.select.empty () || options.schema)
+    return false;
+  bool is_single = (options.numeric_type == "single");
+  if (! is_single && options.numeric_type != "double")
+    return false;
+
+  const char *p = text;
+  const char *end = text + length;
+  while (p != end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+    ++p;
+  if (p == end || *p != '[')
+    return false;
+  const char *first = ++p;
+  while (first != end && (*first == ' ' || *first == '\n' || *first == '\r'
+                          || *first == '\t'))
+    ++first;
+  if (first == end || (*first != '-' && *first != 'n'
+                       && (*first < '0' || *first > '9')))
+    return false;
+
+  phase_timer timer (options.stats, &decode_stats::decode_time);
+  bool decoded;
+  if (is_single)
+    {
+      std::vector<float> values;
+      decoded = parse_numeric_array (p, end, values);
+      if (decoded)
+        {
+          FloatNDArray array (dim_vector (values.size (), 1));
+          std::copy (values.begin (), values.end (), array.fortran_vec ());
+          retval = array;
+        }
+    }
+  else
+    {
+      std::vector<double> values;
+      decoded = parse_numeric_array (p, end, values);
+      if (decoded)
+        {
+          NDArray array (dim_vector (values.size (), 1));
+          std::copy (values.begin (), values.end (), array.fortran_vec ());
+          retval = array;
+        }
+    }
+
+  if (options.stats && decoded)
+    {
+      options.stats->fast_numeric++;
+      options.stats->bytes += length;
+    }
+  else if (options.stats)
+    options.stats->fast_numeric_fallbacks++;
+  return decoded;
+}
+
+//! Decodes a JSON text with the DOM or the streaming decoder depending on
+//! the @c Streaming option, or a JSON Lines text if @c JSONLines is set.
+//!
+//! @param is RapidJSON input stream of the JSON text.
+//! @param options Decoding options with their values.
+//!
+//! @return @ref octave_value that contains the output of decoding the text.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! rapidjson::StringStream ss ("[1, 2, null]");
+//! octave_value value = decode_stream<rapidjson::kParseNanAndInfFlag> (ss,
+//!                                                                    options);
+//! @endcode
+
+template <unsigned parse_flags, typename InputStream>
+octave_value
+decode_stream (InputStream& is, decode_options& options)
+{
+  // The iterative parser doesn't recurse into nested values, so the depth
+  // of the text is only limited by the @c MaxDepth option
+  const unsigned flags = parse_flags | rapidjson::kParseIterativeFlag;
+  parser_arena::lease arena;
+  octave_value retval;
+  if (options.json_lines)
+    retval = decode_lines<flags> (is, *arena, options);
+  else if (options.streaming)
+    retval = sax_decode<flags> (is, arena->reader (), options);
+  else
+    retval = dom_decode<flags> (is, *arena, options);
+
+  if (options.stats)
+    options.stats->bytes += is.Tell ();
+  return retval;
+}
+
+//! Threads that run a task together in rounds.  Each call of @ref run
+//! starts the task once on every worker and waits for all of them, so the
+//! caller can hand out the work of the next round in between.  An exception
+//! thrown by the task is caught on its worker and thrown again by
+//! @ref run on the calling thread, and the workers are stopped and joined
+//! on every exit path, as a joinable @c std::thread that is destroyed calls
+//! @c std::terminate.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! std::vector<int> squares (4);
+//! worker_pool workers (4, [&] (int t) { squares[t] = t * t; });
+//! workers.run ();
+//! @endcode
+
+class worker_pool
+{
+public:
+
+  worker_pool (int n_workers, const std::function<void (int)>& task)
+    : m_task (task), m_threads (), m_mutex (), m_start (), m_done (),
+      m_round (0), m_pending (0), m_stop (false), m_error ()
+  {
+    try
+      {
+        for (int t = 0; t < n_workers; ++t)
+          m_threads.emplace_back (&worker_pool::work, this, t);
+      }
+    catch (...)
+      {
+        stop ();
+        throw;
+      }
+  }
+
+  worker_pool (const worker_pool&) = delete;
+
+  worker_pool& operator = (const worker_pool&) = delete;
+
+  ~worker_pool (void) { stop (); }
+
+  //! Runs the task once on every worker and waits for all of them.
+  void
+  run (void)
+  {
+    std::unique_lock<std::mutex> lock (m_mutex);
+    m_round++;
+    m_pending = m_threads.size ();
+    m_start.notify_all ();
+    m_done.wait (lock, [this] (void) { return m_pending == 0; });
+    if (m_error)
+      {
+        std::exception_ptr error = m_error;
+        m_error = nullptr;
+        std::rethrow_exception (error);
+      }
+  }
+
+private:
+
+  void
+  work (int t)
+  {
+    std::size_t round = 0;
+    while (true)
+      {
+        {
+          std::unique_lock<std::mutex> lock (m_mutex);
+          m_start.wait (lock, [&] (void)
+                                { return m_stop || m_round != round; });
+          if (m_stop)
+            return;
+          round = m_round;
+        }
+
+        std::exception_ptr error;
+        try
+          {
+            m_task (t);
+          }
+        catch (...)
+          {
+            error = std::current_exception ();
+          }
+
+        std::lock_guard<std::mutex> lock (m_mutex);
+        if (error && ! m_error)
+          m_error = error;
+        if (--m_pending == 0)
+          m_done.notify_one ();
+      }
+  }
+
+  void
+  stop (void)
+  {
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_stop = true;
+    }
+    m_start.notify_all ();
+    for (auto& thread : m_threads)
+      thread.join ();
+    m_threads.clear ();
+  }
+
+  std::function<void (int)> m_task;
+
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_mutex;
+
+  //! Signals the workers that a round starts or that they must stop.
+  std::condition_variable m_start;
+
+  //! Signals the caller that the last worker finished its round.
+  std::condition_variable m_done;
+
+  std::size_t m_round;
+
+  std::size_t m_pending;
+
+  bool m_stop;
+
+  //! The first exception of the round.
+  std::exception_ptr m_error;
+};
+
+//! Decodes every JSON text of a cellstr.  All the texts share the same
+//! options, so the sanitized keys are cached across them, and they are
+//! parsed into the arena of the thread that is reset after each text.  If more
+//! than one thread is requested, the texts are parsed in chunks of one text
+//! per worker thread, each into the own arena of its worker, while their
+//! conversion to Octave values stays on the calling thread as it is not
+//! thread safe.  An arena is reset once its text is converted, so at most one
+//! document per worker is in memory.
+//!
+//! @param texts Cell of JSON texts.
+//! @param options Decoding options with their values.
+//!
+//! @return @ref Cell with the same dimensions as @p texts that contains the
+//! decoded texts.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! Cell texts (dim_vector (2, 1));
+//! texts(0) = "[1, 2]";
+//! texts(1) = "{\"a\": 1}";
+//! Cell values = decode_cellstr (texts, options);
+//! @endcode
+
+Cell
+decode_cellstr (const Cell& texts, decode_options& options)
+{
+  const unsigned parse_flags = rapidjson::kParseNanAndInfFlag
+                               | rapidjson::kParseInsituFlag
+                               | rapidjson::kParseIterativeFlag;
+
+  octave_idx_type n = texts.numel ();
+  Cell retval (texts.dims ());
+
+  // The copies of the texts are the buffers that are parsed in situ
+  std::vector<std::string> buffers (n);
+  for (octave_idx_type i = 0; i < n; ++i)
+    buffers[i] = texts(i).string_value ();
+
+  if (options.streaming || options.json_lines)
+    {
+      for (octave_idx_type i = 0; i < n; ++i)
+        {
+          rapidjson::InsituStringStream ss (&buffers[i][0]);
+          retval(i) = decode_stream<parse_flags> (ss, options);
+        }
+    }
+  else if (options.threads <= 1 || n <= 1)
+    {
+      parser_arena::lease arena;
+      for (octave_idx_type i = 0; i < n; ++i)
+        {
+          rapidjson::InsituStringStream ss (&buffers[i][0]);
+          rapidjson::ParseResult result;
+          {
+            phase_timer timer (options.stats, &decode_stats::parse_time);
+            result = arena->parse<parse_flags> (ss);
+          }
+          if (result.IsError ())
+            error("%s: Parse error in element %ld at offset %u: %s\n",
+                  options.who.c_str (), static_cast<long> (i + 1),
+                  (unsigned) result.Offset (),
+                  rapidjson::GetParseError_En (result.Code ()));
+          if (options.stats)
+            {
+              options.stats->bytes += buffers[i].size ();
+              options.stats->dom_nodes += count_nodes (arena->document ());
+            }
+
+          phase_timer timer (options.stats, &decode_stats::decode_time);
+          retval(i) = decode_root (arena->document (), options);
+          arena->reset (options.stats);
+        }
+    }
+  else
+    {
+      // RapidJSON doesn't use Octave, so the texts can be parsed in parallel
+      int n_workers = std::min<octave_idx_type> (options.threads, n);
+      std::vector<std::unique_ptr<parser_arena>> arenas (n_workers);
+      for (auto& arena : arenas)
+        arena.reset (new parser_arena ());
+      std::vector<rapidjson::ParseResult> results (n_workers);
+      octave_idx_type chunk = 0;
+      auto parse_text = [&] (int t)
+        {
+          octave_idx_type i = chunk + t;
+          if (i < n)
+            {
+              rapidjson::InsituStringStream ss (&buffers[i][0]);
+              results[t] = arenas[t]->parse<parse_flags> (ss);
+            }
+        };
+
+      worker_pool workers (n_workers, parse_text);
+      for (; chunk < n; chunk += n_workers)
+        {
+          {
+            // The parse time is the wall time of all the workers
+            phase_timer timer (options.stats, &decode_stats::parse_time);
+            workers.run ();
+          }
+
+          for (int t = 0; t < n_workers && chunk + t < n; ++t)
+            {
+              octave_idx_type i = chunk + t;
+              parser_arena& arena = *arenas[t];
+              if (results[t].IsError ())
+                error("%s: Parse error in element %ld at offset %u: %s\n",
+                      options.who.c_str (), static_cast<long> (i + 1),
+                      (unsigned) results[t].Offset (),
+                      rapidjson::GetParseError_En (results[t].Code ()));
+              if (options.stats)
+                {
+                  options.stats->bytes += buffers[i].size ();
+                  options.stats->dom_nodes += count_nodes (arena.document ());
+                }
+
+              phase_timer timer (options.stats, &decode_stats::decode_time);
+              retval(i) = decode_root (arena.document (), options);
+              arena.reset (options.stats);
+            }
+        }
+    }
+
+  return retval;
+}
+
+//! Decodes a JSON text that is parsed in situ: the text is the only buffer,
+//! the strings and keys are decoded in place inside it.
+//!
+//! @param json The JSON text, which is modified.
+//! @param options Decoding options with their values.
+//!
+//! @return @ref octave_value that contains the output of decoding the text.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! std::string json = "{\"a\": [1, 2]}";
+//! octave_value value = decode_text (json, options);
+//! @endcode
+
+octave_value
+decode_text (std::string& json, decode_options& options)
+{
+  octave_value retval;
+  if (decode_numeric_text (json.data (), json.size (), options, retval))
+    return retval;
+  rapidjson::InsituStringStream ss (&json[0]);
+  return decode_stream<rapidjson::kParseNanAndInfFlag
+                       | rapidjson::kParseInsituFlag> (ss, options);
+}
+
+//! Owns a file opened by @ref decode_file and closes it when it goes out
+//! of scope, also when decoding fails.
+
+class file_reader
+{
+public:
+
+  file_reader (const std::string& filename)
+    : m_file (std::fopen (filename.c_str (), "rb")), m_data (nullptr),
+      m_size (0)
+  { }
+
+  // No copying!
+
+  file_reader (const file_reader&) = delete;
+
+  file_reader& operator = (const file_reader&) = delete;
+
+  ~file_reader (void)
+  {
+#if defined (HAVE_MMAP)
+    if (m_data)
+      munmap (const_cast<char *> (m_data), m_size);
+#endif
+    if (m_file)
+      std::fclose (m_file);
+  }
+
+  bool is_open (void) const { return m_file != nullptr; }
+
+  std::FILE * file (void) { return m_file; }
+
+  //! Maps the whole file into memory if it is a regular file.
+  //!
+  //! @return @c bool that indicates if the file is mapped.
+  bool map (void)
+  {
+#if defined (HAVE_MMAP)
+    struct stat info;
+    int fd = fileno (m_file);
+    if (fstat (fd, &info) != 0 || ! S_ISREG (info.st_mode) || info.st_size == 0)
+      return false;
+
+    void *data = mmap (nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+      return false;
+#  if defined (MADV_SEQUENTIAL)
+    madvise (data, info.st_size, MADV_SEQUENTIAL);
+#  endif
+    m_data = static_cast<const char *> (data);
+    m_size = info.st_size;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  const char * data (void) const { return m_data; }
+
+  std::size_t size (void) const { return m_size; }
+
+private:
+
+  std::FILE *m_file;
+
+  const char *m_data;
+
+  std::size_t m_size;
+};
+
+//! Decodes the JSON text in a file.  Regular files are mapped into memory
+//! and parsed directly from the mapping.  Other files (e.g. pipes) are read
+//! through a buffered stream.  In both cases, the text is never copied into
+//! an Octave value before parsing.
+//!
+//! @param filename The name of the file.
+//! @param options Decoding options with their values.
+//!
+//! @return @ref octave_value that contains the output of decoding the file.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! octave_value value = decode_file ("data.json", options);
+//! @endcode
+
+octave_value
+decode_file (const std::string& filename, decode_options& options)
+{
+  file_reader reader (filename);
+  if (! reader.is_open ())
+    error ("%s: unable to open file '%s'", options.who.c_str (),
+           filename.c_str ());
+
+  if (reader.map ())
+    {
+      octave_value retval;
+      if (decode_numeric_text (reader.data (), reader.size (), options,
+                               retval))
+        return retval;
+      rapidjson::MemoryStream ms (reader.data (), reader.size ());
+      return decode_stream<rapidjson::kParseNanAndInfFlag> (ms, options);
+    }
+
+  char buffer[65536];
+  rapidjson::FileReadStream frs (reader.file (), buffer, sizeof (buffer));
+  return decode_stream<rapidjson::kParseNanAndInfFlag> (frs, options);
+}
+
+//! Compiles the specification of a schema given to jsonschema.
+//!
+//! @param spec A scalar struct whose fields are the keys and whose values
+//! are the types, or a cell array with a column of keys and a column of
+//! types.  A type is a name or a nested specification for objects.
+//!
+//! @return The compiled schema.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_scalar_map spec;
+//! spec.assign ("id", "int64");
+//! spec.assign ("ts", "double");
+//! std::shared_ptr<const json_schema> schema = compile_schema (spec);
+//! @endcode
+
+std::shared_ptr<const json_schema>
+compile_schema (const octave_value& spec)
+{
+  std::vector<std::string> keys;
+  std::vector<octave_value> types;
+  if (spec.isstruct () && spec.numel () == 1)
+    {
+      octave_scalar_map map = spec.scalar_map_value ();
+      string_vector field_names = map.fieldnames ();
+      for (octave_idx_type i = 0; i < field_names.numel (); ++i)
+        {
+          keys.push_back (field_names(i));
+          types.push_back (map.contents (i));
+        }
+    }
+  else if (spec.iscell () && spec.ndims () == 2 && spec.columns () == 2)
+    {
+      Cell cell = spec.cell_value ();
+      for (octave_idx_type i = 0; i < cell.rows (); ++i)
+        {
+          if (! cell(i, 0).is_string ())
+            error ("jsonschema: the keys must be character strings");
+          keys.push_back (cell(i, 0).string_value ());
+          types.push_back (cell(i, 1));
+        }
+    }
+  else
+    error ("jsonschema: SPEC must be a scalar struct or a cell array with "
+           "two columns");
+
+  static const std::vector<std::string> type_names
+    = {"double", "single", "int32", "int64", "logical", "char", "cellstr",
+       "any"};
+
+  auto schema = std::make_shared<json_schema> ();
+  decode_options options;
+  std::unordered_map<std::string, std::size_t> names;
+  for (std::size_t i = 0; i < keys.size (); ++i)
+    {
+      schema_field field;
+      field.key = keys[i];
+      field.name = valid_name (keys[i].c_str (), keys[i].size (), options);
+      if (! names.emplace (field.name, i).second
+          || ! schema->index.emplace (field.key, i).second)
+        error ("jsonschema: duplicate field '%s'", field.name.c_str ());
+
+      if (types[i].is_string ())
+        {
+          std::string type = types[i].string_value ();
+          auto it = std::find (type_names.begin (), type_names.end (), type);
+          if (it == type_names.end ())
+            error ("jsonschema: unknown type '%s' of field '%s'", type.c_str (),
+                   field.key.c_str ());
+          field.type = static_cast<schema_type> (it - type_names.begin ());
+        }
+      else
+        {
+          field.type = struct_field;
+          field.fields = compile_schema (types[i]);
+        }
+      schema->fields.push_back (field);
+    }
+  return schema;
+}
+
+//! Handle to a schema compiled by jsonschema.  It is compiled once and can
+//! be used by many calls of jsondecode with the @c Schema option.
+
+class octave_json_schema : public octave_base_value
+{
+public:
+
+  octave_json_schema (void)
+    : octave_base_value (), m_schema ()
+  { }
+
+  octave_json_schema (const std::shared_ptr<const json_schema>& schema)
+    : octave_base_value (), m_schema (schema)
+  { }
+
+  octave_base_value * clone (void) const
+  {
+    return new octave_json_schema (*this);
+  }
+
+  octave_base_value * empty_clone (void) const
+  {
+    return new octave_json_schema ();
+  }
+
+  bool is_defined (void) const { return true; }
+
+  bool is_constant (void) const { return true; }
+
+  dim_vector dims (void) const { return dim_vector (1, 1); }
+
+  const std::shared_ptr<const json_schema>& schema (void) const
+  {
+    return m_schema;
+  }
+
+  bool print_as_scalar (void) const { return true; }
+
+  void print (std::ostream& os, bool pr_as_read_syntax = false)
+  {
+    print_raw (os, pr_as_read_syntax);
+    newline (os);
+  }
+
+  void print_raw (std::ostream& os, bool = false) const
+  {
+    indent (os);
+    os << "<JSON schema with fields:";
+    for (const auto& field : m_schema->fields)
+      os << ' ' << field.key;
+    os << '>';
+  }
+
+private:
+
+  std::shared_ptr<const json_schema> m_schema;
+
+  DECLARE_OV_TYPEID_FUNCTIONS_AND_DATA
+};
+
+DEFINE_OV_TYPEID_FUNCTIONS_AND_DATA (octave_json_schema, "jsonschema",
+                                     "jsonschema");
+
+//! Splits a path of the @c Select option into its tokens.  A path that
+//! starts with '/' is a JSON Pointer where "~1" and "~0" stand for '/' and
+//! '~', other paths are dotted paths like "results.metrics.0".  An empty
+//! path selects the whole text.
+//!
+//! @param path The path.
+//!
+//! @return The keys and array indices of @p path.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! std::vector<std::string> tokens = split_path ("/results/a~1b/0");
+//! @endcode
+
+std::vector<std::string>
+split_path (const std::string& path)
+{
+  std::vector<std::string> tokens;
+  if (path.empty ())
+    return tokens;
+
+  bool is_pointer = (path[0] == '/');
+  char separator = is_pointer ? '/' : '.';
+  std::size_t begin = is_pointer ? 1 : 0;
+  while (true)
+    {
+      std::size_t end = path.find (separator, begin);
+      std::string token = path.substr (begin, end == std::string::npos
+                                              ? std::string::npos
+                                              : end - begin);
+      if (is_pointer)
+        {
+          std::size_t pos = 0;
+          while ((pos = token.find ('~', pos)) != std::string::npos)
+            {
+              if (pos + 1 < token.size () && token[pos+1] == '1')
+                token.replace (pos, 2, "/");
+              else if (pos + 1 < token.size () && token[pos+1] == '0')
+                token.replace (pos, 2, "~");
+              pos++;
+            }
+        }
+      tokens.push_back (token);
+      if (end == std::string::npos)
+        break;
+      begin = end + 1;
+    }
+  return tokens;
+}
+
+//! Parses the options of jsondecode.
+//!
+//! @param args Pairs of option names and their values.
+//! @param options The options that will be filled with the parsed values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decode_options options;
+//! parse_options (ovl ("Prefix", "m_"), options);
+//! @endcode
+
+void
+parse_options (const octave_value_list& args, decode_options& options)
+{
+  const char *who = options.who.c_str ();
+  for (octave_idx_type i = 0; i < args.length (); ++i)
+    {
+      if (! args(i).is_string ())
+        error ("%s: Option must be character vector", who);
+
+      std::string option_name = args(i++).string_value ();
+      if (octave::string::strcmpi (option_name, "ReplacementStyle"))
+        {
+          if (! args(i).is_string ())
+            error ("%s: Value for options must be character vector", who);
+          std::string option_value = args(i).string_value ();
+          std::transform (option_value.begin (), option_value.end (),
+                          option_value.begin (),
+                          [] (unsigned char c) { return std::tolower (c); });
+          if (option_value != "underscore" && option_value != "delete"
+              && option_value != "hex")
+            error ("%s: Valid values for \'ReplacementStyle\' are "
+                   "\'underscore\', \'delete\' and \'hex\'", who);
+          options.replacement_style = option_value;
+        }
+      else if (octave::string::strcmpi (option_name, "NumericType"))
+        {
+          if (! args(i).is_string ())
+            error ("%s: Value for options must be character vector", who);
+          std::string option_value = args(i).string_value ();
+          std::transform (option_value.begin (), option_value.end (),
+                          option_value.begin (),
+                          [] (unsigned char c) { return std::tolower (c); });
+          if (option_value != "double" && option_value != "single"
+              && option_value != "int32" && option_value != "int64"
+              && option_value != "auto")
+            error ("%s: Valid values for \'NumericType\' are \'double\', "
+                   "\'single\', \'int32\', \'int64\' and \'auto\'", who);
+          options.numeric_type = option_value;
+        }
+      else if (octave::string::strcmpi (option_name, "Select"))
+        {
+          if (! args(i).is_string () && ! args(i).iscellstr ())
+            error ("%s: Value for \'Select\' must be a character vector or "
+                   "a cellstr", who);
+          options.select.clear ();
+          if (args(i).is_string ())
+            options.select.push_back (split_path (args(i).string_value ()));
+          else
+            {
+              Cell paths = args(i).cell_value ();
+              for (octave_idx_type k = 0; k < paths.numel (); ++k)
+                {
+                  std::string path = paths(k).string_value ();
+                  options.select.push_back (split_path (path));
+                }
+            }
+          options.select_paths = args(i);
+        }
+      else if (octave::string::strcmpi (option_name, "Schema"))
+        {
+          if (args(i).type_id () != octave_json_schema::static_type_id ())
+            error ("%s: Value for \'Schema\' must be a schema returned by "
+                   "jsonschema", who);
+          options.schema = dynamic_cast<const octave_json_schema&>
+                             (args(i).get_rep ()).schema ();
+        }
+      else if (octave::string::strcmpi (option_name, "Prefix"))
+        {
+          if (! args(i).is_string ())
+            error ("%s: Value for options must be character vector", who);
+          std::string option_value = args(i).string_value ();
+          if (! is_valid_name (option_value))
+            error ("%s: Invalid \'Prefix\' value \'%s\'", who,
+                   option_value.c_str ());
+          options.prefix = option_value;
+        }
+      else if (octave::string::strcmpi (option_name, "Streaming"))
+        {
+          if (! args(i).is_bool_scalar ())
+            error ("%s: Value for \'Streaming\' must be logical scalar", who);
+          options.streaming = args(i).bool_value ();
+        }
+      else if (octave::string::strcmpi (option_name, "JSONLines"))
+        {
+          if (! args(i).is_bool_scalar ())
+            error ("%s: Value for \'JSONLines\' must be logical scalar", who);
+          options.json_lines = args(i).bool_value ();
+        }
+      else if (octave::string::strcmpi (option_name, "BatchSize"))
+        {
+          double batch_size = args(i).xdouble_value ("%s: Value for "
+                                                     "\'BatchSize\' must be "
+                                                     "a positive integer", who);
+          if (batch_size < 1 || batch_size != octave::math::round (batch_size))
+            error ("%s: Value for \'BatchSize\' must be a positive integer",
+                   who);
+          options.batch_size = batch_size;
+        }
+      else if (octave::string::strcmpi (option_name, "BatchFcn"))
+        {
+          if (! args(i).is_function_handle ())
+            error ("%s: Value for \'BatchFcn\' must be a function handle",
+                   who);
+          options.batch_fcn = args(i);
+        }
+      else if (octave::string::strcmpi (option_name, "Threads"))
+        {
+          double threads = args(i).xdouble_value ("%s: Value for \'Threads\'"
+                                                  " must be a positive "
+                                                  "integer", who);
+          if (threads < 1 || threads != octave::math::round (threads)
+              || octave::math::isinf (threads))
+            error ("%s: Value for \'Threads\' must be a positive integer",
+                   who);
+          // More threads than cores only add overhead to the parsing
+          unsigned cores = std::thread::hardware_concurrency ();
+          options.threads = (cores > 0 && threads > cores) ? cores : threads;
+        }
+      else if (octave::string::strcmpi (option_name, "MaxDepth"))
+        {
+          double max_depth = args(i).xdouble_value ("%s: Value for "
+                                                    "\'MaxDepth\' must be a "
+                                                    "positive integer", who);
+          if (max_depth < 1
+              || (max_depth != octave::math::round (max_depth)
+                  && ! octave::math::isinf (max_depth)))
+            error ("%s: Value for \'MaxDepth\' must be a positive integer",
+                   who);
+          if (max_depth < std::numeric_limits<int>::max ())
+            options.max_depth = max_depth;
+        }
+      else if (octave::string::strcmpi (option_name, "InternStrings"))
+        {
+          if (! args(i).is_bool_scalar ())
+            error ("%s: Value for \'InternStrings\' must be logical scalar",
+                   who);
+          options.intern_strings = args(i).bool_value ();
+        }
+      else if (octave::string::strcmpi (option_name, "Categorical"))
+        {
+          if (! args(i).is_bool_scalar ())
+            error ("%s: Value for \'Categorical\' must be logical scalar",
+                   who);
+          options.categorical = args(i).bool_value ();
+        }
+      else
+        error ("%s: Valid options are \'ReplacementStyle\', \'Prefix\',"
+               " \'NumericType\', \'Select\', \'Schema\', \'Streaming\',"
+               " \'JSONLines\', \'BatchSize\', \'BatchFcn\', \'Threads\',"
+               " \'MaxDepth\', \'InternStrings\' and \'Categorical\'", who);
+    }
+
+  if (options.schema && options.streaming)
+    error ("%s: \'Schema\' can't be used with \'Streaming\'", who);
+
+  if ((options.batch_size > 0 || options.batch_fcn.is_defined ())
+      && ! options.json_lines)
+    error ("%s: \'BatchSize\' and \'BatchFcn\' require \'JSONLines\'",
+           who);
+  // Without a batch size, the function is called once with all the records
+  if (options.batch_fcn.is_defined () && options.batch_size == 0)
+    options.batch_size = std::numeric_limits<octave_idx_type>::max ();
+}
+
+//! A parsed JSON text that is shared by the handles returned by jsonparse.
+//! The text is parsed in situ, so the buffer is kept with the document,
+//! and every subtree is decoded at most once.
+
+struct json_document
+{
+  //! The JSON text that the strings of @c document point into.
+  std::string buffer;
+
+  rapidjson::Document document;
+
+  decode_options options;
+
+  //! The decoded subtrees.
+  std::unordered_map<const rapidjson::Value *, octave_value> decoded;
+
+  //! Decodes a subtree of the document or returns it from @c decoded.
+  const octave_value& decode_value (const rapidjson::Value *val)
+  {
+    auto it = decoded.find (val);
+    if (it == decoded.end ())
+      it = decoded.emplace (val, decode (*val, options)).first;
+    return it->second;
+  }
+};
+
+//! Handle to a value of a parsed JSON text.  Field access with '.' and
+//! element access with '{}' walk the parsed document and only the value
+//! that is reached is decoded, other indexing is done on that decoded value.
+//! Handles to objects are structs, but the functions that take the whole
+//! struct get the decoded object, so they never see a handle as a field.
+//! A default constructed handle refers to a JSON null value.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! auto document = std::make_shared<json_document> ();
+//! document->buffer = "{\"a\": [1, 2]}";
+//! document->document.ParseInsitu (&document->buffer[0]);
+//! octave_value handle (new octave_json_handle (document,
+//!                                              &document->document));
+//! @endcode
+
+class octave_json_handle : public octave_base_value
+{
+public:
+
+  octave_json_handle (void)
+    : octave_base_value (), m_document (std::make_shared<json_document> ()),
+      m_value (&m_document->document)
+  { }
+
+  octave_json_handle (const std::shared_ptr<json_document>& document,
+                      const rapidjson::Value *value)
+    : octave_base_value (), m_document (document), m_value (value)
+  { }
+
+  octave_base_value * clone (void) const
+  {
+    return new octave_json_handle (*this);
+  }
+
+  octave_base_value * empty_clone (void) const
+  {
+    return new octave_json_handle ();
+  }
+
+  bool is_defined (void) const { return true; }
+
+  bool is_constant (void) const { return true; }
+
+  bool isstruct (void) const { return m_value->IsObject (); }
+
+  dim_vector dims (void) const
+  {
+    return dim_vector (m_value->IsArray () ? m_value->Size () : 1, 1);
+  }
+
+  octave_idx_type numel (void) const { return dims ().numel (); }
+
+  //! Returns the decoded value of the handle.
+  const octave_value& value (void) const
+  {
+    return m_document->decode_value (m_value);
+  }
+
+  string_vector map_keys (void) const
+  {
+    std::vector<std::string> field_names;
+    std::vector<octave_idx_type> member_fields;
+    object_layout (*m_value, m_document->options, field_names,
+                   member_fields);
+    string_vector retval (field_names.size ());
+    for (std::size_t i = 0; i < field_names.size (); ++i)
+      retval(i) = field_names[i];
+    return retval;
+  }
+
+  octave_scalar_map scalar_map_value (void) const
+  {
+    if (! m_value->IsObject ())
+      error ("jsonparse: the JSON value is not an object");
+
+    return value ().scalar_map_value ();
+  }
+
+  octave_map map_value (void) const { return scalar_map_value (); }
+
+  octave_value subsref (const std::string& type,
+                        const std::list<octave_value_list>& idx)
+  {
+    octave_value_list retval = subsref (type, idx, 1);
+    return retval.length () > 0 ? retval(0) : octave_value ();
+  }
+
+  octave_value_list subsref (const std::string& type,
+                             const std::list<octave_value_list>& idx,
+                             int nargout)
+  {
+    // Walk the document as long as the indices are keys of objects or
+    // indices of array elements
+    const rapidjson::Value *val = m_value;
+    std::size_t k = 0;
+    auto it = idx.begin ();
+    for (; k < type.length (); ++k, ++it)
+      {
+        const rapidjson::Value *next = nullptr;
+        if (type[k] == '.' && val->IsObject ())
+          {
+            std::string name = (*it)(0).string_value ();
+            for (const auto& pair : val->GetObject ())
+              if (valid_name (pair.name.GetString (),
+                              pair.name.GetStringLength (),
+                              m_document->options) == name)
+                next = &pair.value;
+            if (! next)
+              error ("jsonparse: invalid use of undefined field '%s'",
+                     name.c_str ());
+          }
+        else if (type[k] == '{' && val->IsArray () && it->length () == 1
+                 && (*it)(0).is_scalar_type ())
+          {
+            double index = (*it)(0).double_value ();
+            if (index < 1 || index > val->Size ()
+                || index != octave::math::round (index))
+              error ("jsonparse: index (%g) out of bound %d", index,
+                     static_cast<int> (val->Size ()));
+            next = &(*val)[static_cast<rapidjson::SizeType> (index) - 1];
+          }
+        else
+          break;
+        val = next;
+      }
+
+    const octave_value& retval = m_document->decode_value (val);
+    if (k == type.length ())
+      return retval;
+
+    std::list<octave_value_list> rest (it, idx.end ());
+    return octave_value (retval).subsref (type.substr (k), rest, nargout);
+  }
+
+  bool print_as_scalar (void) const { return true; }
+
+  void print (std::ostream& os, bool pr_as_read_syntax = false)
+  {
+    print_raw (os, pr_as_read_syntax);
+    newline (os);
+  }
+
+  void print_raw (std::ostream& os, bool = false) const
+  {
+    indent (os);
+    if (m_value->IsObject ())
+      {
+        string_vector keys = map_keys ();
+        os << "<JSON object with fields:";
+        for (octave_idx_type i = 0; i < keys.numel (); ++i)
+          os << ' ' << keys(i);
+        os << '>';
+      }
+    else if (m_value->IsArray ())
+      os << "<JSON array with " << m_value->Size () << " elements>";
+    else
+      os << "<JSON value>";
+  }
+
+private:
+
+  std::shared_ptr<json_document> m_document;
+
+  const rapidjson::Value *m_value;
+
+  DECLARE_OV_TYPEID_FUNCTIONS_AND_DATA
+};
+
+DEFINE_OV_TYPEID_FUNCTIONS_AND_DATA (octave_json_handle, "jsonhandle",
+                                     "jsonhandle");
+
+DEFUN_DLD (jsondecode, args, nargout,
+           doc: /* -*- texinfo -*-
+@deftypefn  {} {@var{object} =} jsondecode (@var{json})
+@deftypefnx {} {@var{object} =} jsondecode (@var{json}, "ReplacementStyle", @var{rs})
+@deftypefnx {} {@var{object} =} jsondecode (@var{json}, "Prefix", @var{pfx})
+@deftypefnx {} {@var{object} =} jsondecode (@var{json}, "NumericType", @var{type})
+@deftypefnx {} {@var{object} =} jsondecode (@var{json}, "Select", @var{paths})
+@deftypefnx {} {@var{object} =} jsondecode (@var{json}, "Schema", @var{schema})
+@deftypefnx {} {@var{object} =} jsondecode (@var{json}, "Streaming", @var{streaming})
+@deftypefnx {} {@var{objects} =} jsondecode (@var{jsons}, @dots{})
+@deftypefnx {} {@var{object} =} jsondecode (@var{handle})
+@deftypefnx {} {@var{object} =} jsondecode (@var{json}, @dots{})
+@deftypefnx {} {[@var{object}, @var{stats}] =} jsondecode (@dots{})
+
+Decode text that is formatted in JSON.
+
+The input @var{json} is a string that contains JSON text.
+The output @var{object} is an Octave object that contains the result
+of decoding @var{json}.
+
+For more information about the options @qcode{"ReplacementStyle"} and
+@qcode{"Prefix"}, see @ref{matlab.lang.makeValidName}.
+
+The option @qcode{"NumericType"} chooses the class of the decoded numbers
+and numeric arrays.  It can be @qcode{"double"} (the default),
+@qcode{"single"}, @qcode{"int32"}, @qcode{"int64"} or @qcode{"auto"}.  With
+@qcode{"int32"} and @qcode{"int64"}, numbers and arrays whose values are all
+integers that fit in that class are decoded into it without losing
+precision, other values are still decoded as doubles.  @qcode{"auto"} uses
+int32 if possible, then int64.  JSON null values in numeric arrays are NaN,
+so these arrays are never decoded as integers.
+
+The option @qcode{"Select"} decodes only the values at the given paths.
+A path is either a JSON Pointer like @qcode{"/results/metrics/0"} or a
+dotted path like @qcode{"results.metrics.0"}, where numbers index arrays
+starting from 0.  If @var{paths} is a string, the output is the selected
+value.  If it is a cellstr, the output is a cell array of the same size that
+contains the selected values.  It is an error if a path doesn't exist.
+Together with @qcode{"Streaming"}, the rest of the text is skipped without
+creating any values, so the cost grows with the size of the selected
+values rather than the size of the text.
+
+The option @qcode{"Schema"} decodes JSON objects or arrays of JSON objects
+whose fields are known in advance with a @var{schema} returned by
+@code{jsonschema}.  An array of objects is decoded into a scalar struct whose
+fields are columns with one row per object.  The types of the values aren't
+inferred and the field names are made from the keys once by @code{jsonschema},
+so decoding is faster, and values that don't match the schema are reported as
+errors.  These field names always use the default @qcode{"ReplacementStyle"}
+and @qcode{"Prefix"}, the values of these options are ignored for the fields
+of the schema.  @qcode{"Schema"} can't be used with @qcode{"Streaming"}.
+
+If the value of the option @qcode{"Streaming"} is true, the JSON text is
+decoded while it is being parsed without building the whole document in
+memory first.  This reduces the memory needed to decode large texts.  The
+output is the same in both cases.  The default value for this option is false.
+
+If the value of the option @qcode{"JSONLines"} is true, @var{json} is
+decoded as a sequence of JSON texts separated by newlines (JSON Lines).  It
+is an error if two records are on the same line.  If all the records are
+objects with the same field names, the output is an Nx1 struct array.
+Otherwise, it is an Nx1 cell array of the decoded records.  The option
+@qcode{"BatchSize"} splits the records into batches of at most that many
+records and the output is a cell array of batches.  If a function handle is
+given with the option @qcode{"BatchFcn"}, it is called with every batch
+instead and nothing is returned, so only one batch is kept in memory at a
+time.
+
+If the input is a @var{handle} returned by @code{jsonparse}, the value of the
+handle is decoded with the options given to @code{jsonparse}.
+
+If @var{json} is a cellstr, every element is decoded with the same options
+and the output is a cell array of the same size.  Decoding many small texts
+this way is faster than calling @code{jsondecode} for each of them.  With the
+option @qcode{"Threads"}, the texts are parsed by that many threads, at most
+one per processor core.  The default value for this option is 1.  A single
+text is always parsed by one thread, so the option has no effect on a char
+input.
+
+Nested objects and arrays are decoded without recursion, so deeply nested
+texts don't overflow the stack.  The option @qcode{"MaxDepth"} sets the
+maximum nesting depth of objects and arrays, deeper texts raise an error.
+The default value for this option is @code{Inf}.
+
+If the option @qcode{"InternStrings"} is true, equal strings share one
+character array, which saves memory when few distinct strings repeat many
+times.  If the option @qcode{"Categorical"} is true, arrays of strings are
+decoded into a struct with the field @qcode{"categories"}, a cell array of
+the distinct strings in the order of their first appearance, and the field
+@qcode{"codes"}, a uint32 column vector of the index of each string in
+@qcode{"categories"}.  The default value for both options is false.
+
+If the second output @var{stats} is requested, the call is instrumented and
+@var{stats} is a struct of counters: the time in seconds of the whole call
+(@qcode{"total_time"}) and of its phases (@qcode{"parse_time"},
+@qcode{"decode_time"}, which includes @qcode{"classify_time"} and
+@qcode{"names_time"}), the bytes of parsed text, the number of DOM values,
+the memory high-water mark of the parser arena, the number of texts that
+didn't fit in it and the bytes they allocated outside it, the texts decoded
+by the numeric fast path and the ones that fell back to the parser, the
+arrays decoded as numeric or logical arrays, struct arrays and cells, and
+the hits and misses of the name and string caches.  Without @var{stats}, no
+counter is collected and only @var{object} is returned.
+
+-NOTE: It is not guaranteed to get the same JSON text if you decode
+and then encode it as some names may change by @ref{matlab.lang.makeValidName}.
+
+This table shows the conversions from JSON data types to Octave data types:
+
+@table @asis
+@item @qcode{"Boolean"}
+Scalar @qcode{"logical"}
+
+@item @qcode{"Number"}
+Scalar @qcode{"double"}
+
+@item @qcode{"String"}
+@qcode{"Vector"} of chars
+
+@item JSON @qcode{"Object"}
+Scalar @qcode{"struct"} (field names of the struct may be different from
+the keys of the JSON object due to @ref{matlab.lang.makeValidName})
+
+@item @qcode{"Array"} of different data types
+@qcode{"Cell"} array
+
+@item @qcode{"Array"} of booleans
+@qcode{"Array"} of logicals
+
+@item @qcode{"Array"} of numbers
+@qcode{"Array"} of doubles
+
+@item @qcode{"Array"} of strings
+@qcode{"Cell"} array of vectors of chars
+
+@item @qcode{"Array"} of JSON objects (All objects have the same field names)
+@qcode{"Struct array"}
+
+@item @qcode{"Array"} of JSON objects (Objects have different field names)
+@qcode{"Cell"} array of scalar structs
+
+@item @qcode{"null"} inside a numeric array
+@qcode{"NaN"}
+
+@item @qcode{"null"} inside a non-numeric array
+Empty @qcode{"Array"} of doubles (@qcode{"[]"})
+@end table
+
+Examples:
 
 @example
 @group
@@ -529,29 +5059,370 @@ jsondecode ('{"1": "one", "2": "two"}', 'Prefix', 'm_')
   if (! (nargin % 2))
     print_usage ();
 
-  if(! args(0).is_string ())
-    error ("jsondecode: The input must be a character string");
+  // Handles returned by jsonparse are decoded with the options of jsonparse
+  if (args(0).type_id () == octave_json_handle::static_type_id ())
+    {
+      if (nargin > 1)
+        error ("jsondecode: Options must be given to jsonparse for handles");
+      return dynamic_cast<const octave_json_handle&> (args(0).get_rep ())
+             .value ();
+    }
+
+  if (! args(0).is_string () && ! args(0).iscellstr ())
+    error ("jsondecode: The input must be a character string or a cellstr");
+
+  decode_options options;
+  parse_options (args.slice (1, nargin-1), options);
+
+  // The counters are only collected if they are requested
+  decode_stats stats;
+  if (nargout > 1)
+    options.stats = &stats;
+
+  octave_value retval;
+  {
+    phase_timer timer (options.stats, &decode_stats::total_time);
+    if (args(0).iscellstr ())
+      retval = decode_cellstr (args(0).cell_value (), options);
+    else
+      {
+        std::string json = args (0).string_value ();
+        retval = decode_text (json, options);
+      }
+  }
+  if (nargout > 1)
+    return ovl (retval, stats.map_value ());
+  return ovl (retval);
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecode",
+                        "RapidJSON is required for JSON encoding\\decoding");
+
+#endif
+}
+
+// PKG_ADD: autoload ("jsondecodefile", "jsondecode.oct");
+
+DEFUN_DLD (jsondecodefile, args, nargout,
+           doc: /* -*- texinfo -*-
+@deftypefn  {} {@var{object} =} jsondecodefile (@var{filename})
+@deftypefnx {} {@var{object} =} jsondecodefile (@var{filename}, @dots{})
+@deftypefnx {} {[@var{object}, @var{stats}] =} jsondecodefile (@dots{})
+
+Decode the JSON text in the file @var{filename}.
+
+This is equivalent to @code{jsondecode (fileread (@var{filename}), @dots{})}
+but the file is parsed directly without reading it into an Octave string
+first.  Regular files are mapped into memory, other files such as pipes are
+read through a buffered stream.
+
+The same options as for @code{jsondecode} are accepted, and the optional
+output @var{stats} has the same fields.
+
+Example:
+
+@example
+@group
+jsondecodefile ("results.json", "ReplacementStyle", "delete")
+jsondecodefile ("events.jsonl", "JSONLines", true, "BatchSize", 1000,
+                "BatchFcn", @@(batch) disp (numel (batch)))
+@end group
+@end example
+
+@seealso{jsondecode, jsonparse, fileread}
+@end deftypefn */)
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+  // Options must be in pairs
+  if (! (nargin % 2))
+    print_usage ();
+
+  if (! args(0).is_string ())
+    error ("jsondecodefile: FILENAME must be a character string");
+
+  decode_options options;
+  options.who = "jsondecodefile";
+  parse_options (args.slice (1, nargin-1), options);
+
+  decode_stats stats;
+  if (nargout > 1)
+    options.stats = &stats;
+
+  std::string filename
+    = octave::sys::file_ops::tilde_expand (args(0).string_value ());
+  octave_value retval;
+  {
+    phase_timer timer (options.stats, &decode_stats::total_time);
+    retval = decode_file (filename, options);
+  }
+  if (nargout > 1)
+    return ovl (retval, stats.map_value ());
+  return ovl (retval);
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsondecodefile",
+                        "RapidJSON is required for JSON encoding\\decoding");
+
+#endif
+}
+
+// PKG_ADD: autoload ("jsonparse", "jsondecode.oct");
+
+DEFUN_DLD (jsonparse, args, ,
+           doc: /* -*- texinfo -*-
+@deftypefn  {} {@var{handle} =} jsonparse (@var{json})
+@deftypefnx {} {@var{handle} =} jsonparse (@var{json}, @dots{})
+
+Parse text that is formatted in JSON without decoding it.
+
+The output @var{handle} refers to the parsed text that is kept in memory.
+Only the values that are accessed through @var{handle} are decoded, and
+each of them is decoded once, so looking up a few values of a large text
+is much faster than decoding the whole text with @code{jsondecode}.
+
+Fields of JSON objects are accessed with @code{.} and elements of JSON
+arrays with @code{@{@}}, as in @code{@var{handle}.results@{2@}.name}.
+The value that is reached is decoded like @code{jsondecode} does and any
+other indexing is done on the decoded value.  @code{numel} of a handle is
+the number of elements of a JSON array, and @code{fieldnames} returns the
+field names of a JSON object.  @code{jsondecode (@var{handle})} decodes the
+whole value.
+
+The options @qcode{"ReplacementStyle"}, @qcode{"Prefix"} and
+@qcode{"NumericType"} are used like in @code{jsondecode}.
+
+Example:
+
+@example
+@group
+h = jsonparse ('@{"results": [@{"name": "a"@}, @{"name": "b"@}]@}');
+h.results@{2@}.name
+@result{} b
+@end group
+@end example
+
+@seealso{jsondecode}
+@end deftypefn */)
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+  // Options must be in pairs
+  if (! (nargin % 2))
+    print_usage ();
+
+  if (! args(0).is_string ())
+    error ("jsonparse: The input must be a character string");
 
-  std::string json = args (0).string_value ();
-  rapidjson::Document d;
-  // DOM is chosen instead of SAX as SAX publishes events to a handler that
-  // decides what to do depending on the event only. This will cause a problem
-  // in decoding JSON arrays as the output may be an array or a cell and that
-  // doesn't only depend on the event (startArray) but also on the types of
-  // the elements inside the array
-  d.Parse <rapidjson::kParseNanAndInfFlag>(json.c_str ());
+  auto document = std::make_shared<json_document> ();
+  document->options.who = "jsonparse";
+  parse_options (args.slice (1, nargin-1), document->options);
+  if (document->options.streaming || document->options.json_lines
+      || ! document->options.select.empty () || document->options.schema)
+    error ("jsonparse: \'Streaming\', \'JSONLines\', \'Select\' and "
+           "\'Schema\' can't be used with jsonparse");
 
+  document->buffer = args(0).string_value ();
+  rapidjson::Document& d = document->document;
+  d.ParseInsitu<rapidjson::kParseNanAndInfFlag
+                | rapidjson::kParseIterativeFlag> (&document->buffer[0]);
   if (d.HasParseError ())
-    error("jsondecode: Parse error at offset %u: %s\n",
+    error("jsonparse: Parse error at offset %u: %s\n",
           (unsigned)d.GetErrorOffset (),
           rapidjson::GetParseError_En (d.GetParseError ()));
-  return decode (d, args.slice (1, nargin-1));
+
+  static bool type_registered = false;
+  if (! type_registered)
+    {
+      octave_json_handle::register_type ();
+      // Handles must not outlive the code of their type
+      mlock ();
+      type_registered = true;
+    }
+
+  return octave_value (new octave_json_handle (document, &d));
 
 #else
 
   octave_unused_parameter (args);
 
-  err_disabled_feature ("jsondecode",
+  err_disabled_feature ("jsonparse",
+                        "RapidJSON is required for JSON encoding\\decoding");
+
+#endif
+}
+
+// PKG_ADD: autoload ("jsonschema", "jsondecode.oct");
+
+DEFUN_DLD (jsonschema, args, ,
+           doc: /* -*- texinfo -*-
+@deftypefn {} {@var{schema} =} jsonschema (@var{spec})
+
+Compile a schema for the @qcode{"Schema"} option of @code{jsondecode}.
+
+The input @var{spec} is a scalar struct whose field names are the keys of
+the JSON objects and whose values are their types, or a cell array with
+a column of keys and a column of types for keys that aren't valid field
+names.  The types are:
+
+@table @asis
+@item @qcode{"double"}, @qcode{"single"}
+A number or null, which is decoded as NaN.
+
+@item @qcode{"int32"}, @qcode{"int64"}
+An integer that fits in the class.
+
+@item @qcode{"logical"}
+A Boolean.
+
+@item @qcode{"char"}
+A string.
+
+@item @qcode{"cellstr"}
+An array of strings.
+
+@item @qcode{"any"}
+Any value, decoded like @code{jsondecode} does.
+
+@item A struct or a cell array
+A JSON object with the fields of that nested specification.
+@end table
+
+The output @var{schema} is compiled once and can be used by many calls of
+@code{jsondecode}.  The field names of the output are made from the keys by
+@ref{matlab.lang.makeValidName} with its default options.  All the fields
+of the schema must be present in every object and objects must not have
+other fields.
+
+Example:
+
+@example
+@group
+s = jsonschema (struct ("id", "int64", "ts", "double", "tags", "cellstr"));
+msgs = jsondecode (json, "Schema", s);
+msgs.id
+@end group
+@end example
+
+@seealso{jsondecode}
+@end deftypefn */)
+{
+#if defined (HAVE_RAPIDJSON)
+
+  if (args.length () != 1)
+    print_usage ();
+
+  std::shared_ptr<const json_schema> schema = compile_schema (args(0));
+
+  static bool type_registered = false;
+  if (! type_registered)
+    {
+      octave_json_schema::register_type ();
+      // Schemas must not outlive the code of their type
+      mlock ();
+      type_registered = true;
+    }
+
+  return octave_value (new octave_json_schema (schema));
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("jsonschema",
+                        "RapidJSON is required for JSON encoding\\decoding");
+
+#endif
+}
+
+// PKG_ADD: autoload ("__jsondecode_arena__", "jsondecode.oct");
+
+DEFUN_DLD (__jsondecode_arena__, args, ,
+           doc: /* -*- texinfo -*-
+@deftypefn {} {@var{info} =} __jsondecode_arena__ ()
+Undocumented internal function.
+
+Return the sizes in bytes of the buffers that @code{jsondecode} keeps
+between calls for parsing on the calling thread, @qcode{"values"} and
+@qcode{"stack"}, the largest memory that a text needed, @qcode{"peak"},
+the maximum size of each buffer, @qcode{"limit"}, and the number of texts
+parsed, @qcode{"parses"}.
+@end deftypefn */)
+{
+#if defined (HAVE_RAPIDJSON)
+
+  if (args.length () != 0)
+    print_usage ();
+
+  return octave_value (parser_arena::thread_arena ().report ());
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("__jsondecode_arena__",
+                        "RapidJSON is required for JSON encoding\\decoding");
+
+#endif
+}
+
+// PKG_ADD: autoload ("__jsondecode_bench__", "jsondecode.oct");
+
+DEFUN_DLD (__jsondecode_bench__, args, ,
+           doc: /* -*- texinfo -*-
+@deftypefn {} {[@var{times}, @var{value}] =} __jsondecode_bench__ (@var{json}, @var{n}, @dots{})
+Undocumented internal function.
+
+Decode the JSON text @var{json} @var{n} times with the options of
+@code{jsondecode} and return the time in seconds of each decoding in
+@var{times} and the decoded value in @var{value}.  Only the decoding is
+timed, without the call of the function, the copy of the text and the
+parsing of the options, so that benchmarks measure the decoder itself.
+@end deftypefn */)
+{
+#if defined (HAVE_RAPIDJSON)
+
+  int nargin = args.length ();
+  if (nargin < 2 || nargin % 2)
+    print_usage ();
+
+  std::string text = args(0).xstring_value ("__jsondecode_bench__: JSON must "
+                                            "be a character string");
+  octave_idx_type n = args(1).xidx_type_value ("__jsondecode_bench__: N must "
+                                               "be an integer");
+  decode_options options;
+  parse_options (args.slice (2, nargin-2), options);
+
+  NDArray times (dim_vector (n, 1));
+  octave_value value;
+  std::string json;
+  for (octave_idx_type i = 0; i < n; ++i)
+    {
+      // Each decoding starts with empty caches like a call of jsondecode
+      decode_options call_options = options;
+      json = text;
+      auto start = std::chrono::steady_clock::now ();
+      value = decode_text (json, call_options);
+      std::chrono::duration<double> elapsed
+        = std::chrono::steady_clock::now () - start;
+      times(i) = elapsed.count ();
+    }
+
+  return ovl (times, value);
+
+#else
+
+  octave_unused_parameter (args);
+
+  err_disabled_feature ("__jsondecode_bench__",
                         "RapidJSON is required for JSON encoding\\decoding");
 
 #endif
@@ -23,187 +23,829 @@
 //
 ////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201703L
+#  include <charconv>
+#endif
+
 #include <octave/oct.h>
 #include "oct-string.h"
 #include "builtin-defun-decls.h"
+
+// RapidJSON scans strings with SIMD instructions if the build targets them
+#if defined (__SSE4_2__)
+#  define RAPIDJSON_SSE42
+#elif defined (__SSE2__)
+#  define RAPIDJSON_SSE2
+#elif defined (__ARM_NEON)
+#  define RAPIDJSON_NEON
+#endif
+
 #include "rapidjson/writer.h"
 #include "rapidjson/prettywriter.h"
 #include "rapidjson/stringbuffer.h"
 
-//! Encodes a scalar Octave value into a numerical JSON value.
+//! Counters of a jsonencode call that are collected when its second output
+//! is requested.
+
+struct encode_stats
+{
+  //! Time in seconds of the whole call.
+  double total_time = 0;
+
+  //! Bytes of the JSON text.
+  std::size_t bytes = 0;
+
+  //! Scalars encoded by @ref encode_numeric.
+  std::size_t scalars = 0;
+
+  //! Numeric and logical arrays.
+  std::size_t arrays = 0;
+
+  //! Character arrays.
+  std::size_t strings = 0;
+
+  //! Structs, struct arrays, objects and containers.Map objects.
+  std::size_t structs = 0;
+
+  //! Cell arrays.
+  std::size_t cells = 0;
+
+  //! Numbers written by @ref write_decimal.
+  std::size_t decimals = 0;
+
+  //! Returns the counters as a struct.
+  octave_scalar_map
+  map_value (void) const
+  {
+    octave_scalar_map retval;
+    retval.assign ("total_time", total_time);
+    retval.assign ("bytes", static_cast<double> (bytes));
+    retval.assign ("scalars", static_cast<double> (scalars));
+    retval.assign ("arrays", static_cast<double> (arrays));
+    retval.assign ("strings", static_cast<double> (strings));
+    retval.assign ("structs", static_cast<double> (structs));
+    retval.assign ("cells", static_cast<double> (cells));
+    retval.assign ("decimals", static_cast<double> (decimals));
+    return retval;
+  }
+};
+
+//! Options of a jsonencode call.
+
+struct encode_options
+{
+  //! Encode @c Inf and @c NaN as @c null.
+  bool convert_inf_and_nan = true;
+
+  //! Number of significant digits of the numbers that aren't integers, 0
+  //! for the shortest digits that are read back as the same number.
+  int significant_digits = 0;
+
+  //! Counters of the call, null unless they are requested.
+  encode_stats *stats = nullptr;
+};
+
+//! Writes a logical element of an array.
 //!
 //! @param writer RapidJSON's writer that is responsible for generating json.
-//! @param obj scalar Octave value.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
+//! @param value The element.
+//! @param options Encoding options with their values.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
-//! octave_value obj (7);
-//! encode_numeric (writer, obj,true);
+//! encode_options options;
+//! write_element (writer, true, options);
 //! @endcode
 
 template <typename T> void
-encode_numeric (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
+write_element (T& writer, bool value, const encode_options&)
 {
-  double value =  obj.scalar_value ();
-  if (obj.is_bool_scalar ())
-    writer.Bool (obj.bool_value ());
+  writer.Bool (value);
+}
+
+//! The decimal digits of a positive number: the number is
+//! @c digits times 10 to the power of @c exponent.
+
+struct decimal
+{
+  char digits[32];
+  int length;
+  int exponent;
+};
+
+//! Reads the digits of a number printed in scientific notation, e.g.
+//! "1.2345e+02", and drops their trailing zeros.
+//!
+//! @param text The number in scientific notation.
+//! @param end The end of @p text.
+//! @param dec The digits of the number.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decimal dec;
+//! read_scientific ("1.50e+02", "1.50e+02" + 8, dec);
+//! @endcode
+
+void
+read_scientific (const char *text, const char *end, decimal& dec)
+{
+  dec.length = 0;
+  const char *p = text;
+  for (; p != end && *p != 'e'; ++p)
+    if (*p != '.')
+      dec.digits[dec.length++] = *p;
+
+  int exponent = std::atoi (std::string (p + 1, end).c_str ());
+  while (dec.length > 1 && dec.digits[dec.length-1] == '0')
+    dec.length--;
+  dec.exponent = exponent - dec.length + 1;
+}
+
+//! Finds the shortest digits that are read back as the same double.
+//!
+//! @param value A positive finite number.
+//! @param dec The digits of @p value.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decimal dec;
+//! shortest_digits (0.1, dec);
+//! @endcode
+
+void
+shortest_digits (double value, decimal& dec)
+{
+#if defined (__cpp_lib_to_chars)
+  char text[32];
+  std::to_chars_result result
+    = std::to_chars (text, text + sizeof (text), value,
+                     std::chars_format::scientific);
+  read_scientific (text, result.ptr, dec);
+#else
+  // The Grisu2 algorithm of RapidJSON's writer
+  rapidjson::internal::Grisu2 (value, dec.digits, &dec.length, &dec.exponent);
+#endif
+}
+
+//! Finds the shortest digits that are read back as the same single.
+//!
+//! @param value A positive finite number.
+//! @param dec The digits of @p value.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decimal dec;
+//! shortest_digits (0.1f, dec);
+//! @endcode
+
+void
+shortest_digits (float value, decimal& dec)
+{
+  char text[32];
+#if defined (__cpp_lib_to_chars)
+  std::to_chars_result result
+    = std::to_chars (text, text + sizeof (text), value,
+                     std::chars_format::scientific);
+  read_scientific (text, result.ptr, dec);
+#else
+  // 9 significant digits are always enough for a single
+  for (int precision = 6; precision <= 9; ++precision)
+    {
+      int length = std::snprintf (text, sizeof (text), "%.*e",
+                                  precision - 1, value);
+      if (std::strtof (text, nullptr) == value || precision == 9)
+        {
+          read_scientific (text, text + length, dec);
+          break;
+        }
+    }
+#endif
+}
+
+//! Rounds a number to a number of significant digits.
+//!
+//! @param value A positive finite number.
+//! @param precision The number of significant digits, from 1 to 17.
+//! @param dec The digits of @p value.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decimal dec;
+//! rounded_digits (3.14159, 3, dec);
+//! @endcode
+
+void
+rounded_digits (double value, int precision, decimal& dec)
+{
+  char text[32];
+#if defined (__cpp_lib_to_chars)
+  std::to_chars_result result
+    = std::to_chars (text, text + sizeof (text), value,
+                     std::chars_format::scientific, precision - 1);
+  read_scientific (text, result.ptr, dec);
+#else
+  int length = std::snprintf (text, sizeof (text), "%.*e", precision - 1,
+                              value);
+  read_scientific (text, text + length, dec);
+#endif
+}
+
+//! Prints the digits of a number in the notation of RapidJSON's writer:
+//! fixed notation with at least one decimal for numbers below 1e21 and
+//! above 1e-7, scientific notation otherwise.
+//!
+//! @param dec The digits of the number.
+//! @param text The buffer of at least 48 characters the number is printed
+//! into.
+//!
+//! @return The number of printed characters.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! decimal dec;
+//! shortest_digits (1234.5, dec);
+//! char text[48];
+//! int length = print_decimal (dec, text);
+//! @endcode
+
+int
+print_decimal (const decimal& dec, char *text)
+{
+  // The position of the decimal point relative to the first digit
+  int point = dec.length + dec.exponent;
+  char *p = text;
+
+  if (dec.exponent >= 0 && point <= 21)
+    {
+      // 1234e7 -> 12340000000.0
+      p = std::copy (dec.digits, dec.digits + dec.length, p);
+      p = std::fill_n (p, dec.exponent, '0');
+      *p++ = '.';
+      *p++ = '0';
+    }
+  else if (0 < point && point <= 21)
+    {
+      // 1234e-2 -> 12.34
+      p = std::copy (dec.digits, dec.digits + point, p);
+      *p++ = '.';
+      p = std::copy (dec.digits + point, dec.digits + dec.length, p);
+    }
+  else if (-6 < point && point <= 0)
+    {
+      // 1234e-6 -> 0.001234
+      *p++ = '0';
+      *p++ = '.';
+      p = std::fill_n (p, -point, '0');
+      p = std::copy (dec.digits, dec.digits + dec.length, p);
+    }
+  else
+    {
+      // 1234e30 -> 1.234e33
+      *p++ = dec.digits[0];
+      if (dec.length > 1)
+        {
+          *p++ = '.';
+          p = std::copy (dec.digits + 1, dec.digits + dec.length, p);
+        }
+      *p++ = 'e';
+      p += std::sprintf (p, "%d", point - 1);
+    }
+  return p - text;
+}
+
+//! Writes a finite number that isn't an integer with the digits chosen by
+//! the @c SignificantDigits option.  The number is printed like RapidJSON's
+//! writer prints doubles.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param value A finite double or single.
+//! @param options Encoding options with their values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! encode_options options;
+//! options.significant_digits = 3;
+//! write_decimal (writer, 3.14159, options);
+//! @endcode
+
+template <typename T, typename F> void
+write_decimal (T& writer, F value, const encode_options& options)
+{
+  if (value == 0)
+    {
+      writer.Double (value);
+      return;
+    }
+
+  decimal dec;
+  F magnitude = (value < 0 ? -value : value);
+  if (options.significant_digits > 0)
+    rounded_digits (magnitude, options.significant_digits, dec);
+  else
+    shortest_digits (magnitude, dec);
+
+  char text[48];
+  int length = 0;
+  if (value < 0)
+    text[length++] = '-';
+  length += print_decimal (dec, text + length);
+  writer.RawValue (text, length, rapidjson::kNumberType);
+
+  if (options.stats)
+    options.stats->decimals++;
+}
+
+//! Writes a double or single.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param value The number.
+//! @param options Encoding options with their values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! encode_options options;
+//! write_real (writer, 1.5, options);
+//! @endcode
+
+template <typename T, typename F> void
+write_real (T& writer, F value, const encode_options& options)
+{
+  double x = value;
   // Any numeric input from the interpreter will be in double type so in order
   // to detect ints, we will check if the floor of the input and the input are
   // equal using fabs(A - B) < epsilon method as it is more accurate.
   // If value > 999999, MATLAB will encode it in scientific notation (double)
-  else if (fabs (floor (value) - value) < std::numeric_limits<double>::epsilon ()
-           && value <= 999999 && value >= -999999)
-    writer.Int64 (value);
+  if (fabs (floor (x) - x) < std::numeric_limits<double>::epsilon ()
+      && x <= 999999 && x >= -999999)
+    writer.Int64 (x);
   // NA values doesn't exist in MATLAB, so I will decode it as null instead
-  else if (((octave::math::isnan (value) || std::isinf (value)
-            || std::isinf (-value)) && ConvertInfAndNaN)
-           || obj.isna ().bool_value ())
+  else if (((octave::math::isnan (x) || std::isinf (x))
+            && options.convert_inf_and_nan)
+           || octave::math::isna (value))
     writer.Null ();
+  else if (octave::math::isnan (x) || std::isinf (x))
+    writer.Double (x);
+  else
+    write_decimal (writer, value, options);
+}
+
+//! Writes a double element of an array.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param value The element.
+//! @param options Encoding options with their values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! encode_options options;
+//! write_element (writer, 1.5, options);
+//! @endcode
+
+template <typename T> void
+write_element (T& writer, double value, const encode_options& options)
+{
+  write_real (writer, value, options);
+}
+
+//! Writes a single element of an array.  Its shortest digits are the ones
+//! that are read back as the same single.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param value The element.
+//! @param options Encoding options with their values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! encode_options options;
+//! write_element (writer, 1.5f, options);
+//! @endcode
+
+template <typename T> void
+write_element (T& writer, float value, const encode_options& options)
+{
+  write_real (writer, value, options);
+}
+
+//! Writes an integer element of an array with RapidJSON's integer
+//! formatter.  The value is written exactly, also for 64-bit integers
+//! that a double can't hold.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param value The element.
+//! @param options Encoding options with their values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! encode_options options;
+//! write_element (writer, octave_int64 (9007199254740993LL), options);
+//! @endcode
+
+template <typename T, typename I> void
+write_element (T& writer, const octave_int<I>& value, const encode_options&)
+{
+  I integer = value.value ();
+  if (std::numeric_limits<I>::is_signed)
+    writer.Int64 (integer);
+  else
+    writer.Uint64 (integer);
+}
+
+//! Encodes a scalar Octave value into a numerical JSON value.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param obj scalar Octave value.
+//! @param options Encoding options with their values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_value obj (7);
+//! encode_options options;
+//! encode_numeric (writer, obj, options);
+//! @endcode
+
+template <typename T> void
+encode_numeric (T& writer, const octave_value& obj,
+                const encode_options& options)
+{
+  if (obj.is_bool_scalar ())
+    write_element (writer, obj.bool_value (), options);
   else if (obj.is_double_type ())
-    writer.Double (value);
+    write_element (writer, obj.double_value (), options);
+  else if (obj.is_single_type ())
+    write_element (writer, obj.float_value (), options);
+  else if (obj.is_int8_type ())
+    write_element (writer, obj.int8_scalar_value (), options);
+  else if (obj.is_int16_type ())
+    write_element (writer, obj.int16_scalar_value (), options);
+  else if (obj.is_int32_type ())
+    write_element (writer, obj.int32_scalar_value (), options);
+  else if (obj.is_int64_type ())
+    write_element (writer, obj.int64_scalar_value (), options);
+  else if (obj.is_uint8_type ())
+    write_element (writer, obj.uint8_scalar_value (), options);
+  else if (obj.is_uint16_type ())
+    write_element (writer, obj.uint16_scalar_value (), options);
+  else if (obj.is_uint32_type ())
+    write_element (writer, obj.uint32_scalar_value (), options);
+  else if (obj.is_uint64_type ())
+    write_element (writer, obj.uint64_scalar_value (), options);
   else
     error ("jsonencode: Unsupported type.");
 }
 
-//! Encodes character vectors and arrays into JSON strings.
+//! Checks if a character must be escaped in a JSON string.  These are the
+//! characters that RapidJSON's writer escapes.
+
+inline bool
+needs_escape (char c)
+{
+  return static_cast<unsigned char> (c) < 0x20 || c == '"' || c == '\\';
+}
+
+//! Finds the first character of a string that must be escaped.  Eight
+//! characters are checked at once as the bytes of a 64-bit word.
+//!
+//! @param str Pointer to the characters of the string.
+//! @param length The number of characters in @p str.
+//!
+//! @return The number of characters before the first one that must be
+//! escaped, or @p length if there is none.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! std::size_t n = unescaped_prefix ("foo\n", 4);
+//! @endcode
+
+std::size_t
+unescaped_prefix (const char *str, std::size_t length)
+{
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t highs = 0x8080808080808080ULL;
+  const uint64_t quotes = ones * '"';
+  const uint64_t backslashes = ones * '\\';
+
+  std::size_t i = 0;
+  for (; i + 8 <= length; i += 8)
+    {
+      uint64_t word;
+      std::memcpy (&word, str + i, 8);
+      // The high bit of a byte is set if it is less than 0x20, or if it
+      // is zero after the XOR with a quote or a backslash
+      uint64_t x = word ^ quotes;
+      uint64_t y = word ^ backslashes;
+      uint64_t found = ((word - ones * 0x20) & ~word)
+                       | ((x - ones) & ~x) | ((y - ones) & ~y);
+      if (found & highs)
+        break;
+    }
+
+  while (i < length && ! needs_escape (str[i]))
+    ++i;
+  return i;
+}
+
+//! Escapes a string into a quoted JSON string.  The runs of characters that
+//! don't need to be escaped are copied at once and the others are escaped
+//! like RapidJSON's writer does.  It is used for the keys of structs, which
+//! are escaped once for all the elements of a struct array.
+//!
+//! @param str Pointer to the characters of the string.
+//! @param length The number of characters in @p str.
+//! @param json The string that the JSON string is appended to.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! std::string json;
+//! escape_string ("foo\n", 4, json);
+//! @endcode
+
+void
+escape_string (const char *str, std::size_t length, std::string& json)
+{
+  static const char hex_digits[] = "0123456789ABCDEF";
+
+  json.reserve (json.size () + length + 2);
+  json += '"';
+  std::size_t i = 0;
+  while (true)
+    {
+      std::size_t run = unescaped_prefix (str + i, length - i);
+      json.append (str + i, run);
+      i += run;
+      if (i == length)
+        break;
+
+      unsigned char c = str[i++];
+      json += '\\';
+      switch (c)
+        {
+        case '"': json += '"'; break;
+        case '\\': json += '\\'; break;
+        case '\b': json += 'b'; break;
+        case '\f': json += 'f'; break;
+        case '\n': json += 'n'; break;
+        case '\r': json += 'r'; break;
+        case '\t': json += 't'; break;
+        default:
+          json += "u00";
+          json += hex_digits[c >> 4];
+          json += hex_digits[c & 0xF];
+          break;
+        }
+    }
+  json += '"';
+}
+
+//! Writes a string into JSON.  RapidJSON's writer escapes the characters
+//! straight from @p str, with SIMD instructions if the build targets them.
 //!
 //! @param writer RapidJSON's writer that is responsible for generating json.
-//! @param obj character vectors or character arrays.
-//! @param original_dims The original dimensions of the array being encoded.
+//! @param str Pointer to the characters of the string.
+//! @param length The number of characters in @p str.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! write_string (writer, "foo\n", 4);
+//! @endcode
+
+template <typename T> void
+write_string (T& writer, const char *str, std::size_t length)
+{
+  writer.String (str, static_cast<rapidjson::SizeType> (length));
+}
+
+//! Writes the characters of a character array that are selected by an
+//! offset and a stride as one or more JSON strings.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param data The data of the character array.
+//! @param length The number of selected characters.
+//! @param stride The distance in @p data between two selected characters.
+//! @param string_length The number of characters of each string.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! charNDArray array (dim_vector (2, 3), 'a');
+//! write_strings (writer, array.data (), 3, 2, 3);
+//! @endcode
+
+template <typename T> void
+write_strings (T& writer, const char *data, octave_idx_type length,
+               octave_idx_type stride, octave_idx_type string_length)
+{
+  // Contiguous characters are handed to the writer where they are
+  if (stride == 1)
+    {
+      for (octave_idx_type i = 0; i + string_length <= length;
+           i += string_length)
+        write_string (writer, data + i, string_length);
+      return;
+    }
+
+  static thread_local std::string chars;
+  chars.resize (string_length);
+  for (octave_idx_type i = 0; i + string_length <= length;
+       i += string_length)
+    {
+      for (octave_idx_type k = 0; k < string_length; ++k)
+        chars[k] = data[(i + k) * stride];
+      write_string (writer, chars.data (), string_length);
+    }
+}
+
+//! Encodes a part of a character array into JSON strings.  The part is
+//! described by its dimensions and by the offset of its first character in
+//! the data of the whole array, so no sub array is created.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param array The whole character array.
+//! @param strides The distance in the data between two consecutive elements
+//! of each dimension of @p array.
+//! @param dims The dimensions of the part, the dimensions of @p array with
+//! the dimensions that are already split set to 1.
+//! @param offset The index in the data of the first character of the part.
 //! @param level The level of recursion for the function.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
-//! octave_value obj ("foo");
-//! encode_string (writer, obj,true);
+//! charNDArray array (dim_vector (2, 2, 2), 'a');
+//! std::vector<octave_idx_type> strides ({1, 2, 4});
+//! std::vector<octave_idx_type> dims ({2, 2, 2});
+//! encode_strided_string (writer, array, strides, dims, 0, 0);
 //! @endcode
 
 template <typename T> void
-encode_string (T& writer, const octave_value& obj,
-               const dim_vector& original_dims, int level = 0)
+encode_strided_string (T& writer, const charNDArray& array,
+                       const std::vector<octave_idx_type>& strides,
+                       std::vector<octave_idx_type>& dims,
+                       octave_idx_type offset, int level = 0)
 {
-  charNDArray array = obj.char_array_value ();
-  if (array.isempty ())
-    writer.String ("");
-  else if (array.isvector ())
+  const dim_vector& original_dims = array.dims ();
+  const char *data = array.data () + offset;
+
+  // The number of dimensions of the part without its trailing singleton
+  // dimensions, as for a sub array
+  int ndims = dims.size ();
+  while (ndims > 2 && dims[ndims-1] == 1)
+    ndims--;
+
+  int dim = -1;
+  int n_dims = 0;
+  for (int i = 0; i < ndims; ++i)
+    if (dims[i] != 1)
+      {
+        dim = (dim < 0 ? i : dim);
+        n_dims++;
+      }
+
+  if (n_dims <= 1)
     {
+      octave_idx_type length = (dim < 0 ? 1 : dims[dim]);
+      octave_idx_type stride = (dim < 0 ? 1 : strides[dim]);
+
       // Handle the special case when the input is a vector with more than
       // 2 dimensions (e.g. cat (8, ['a'], ['c'])). In this case, we don't
       // split the inner vectors of the input. we merge them into one.
       if (level == 0)
         {
-          std::string char_vector = "";
-          for (octave_idx_type i = 0; i < array.numel (); ++i)
-            char_vector += array(i);
-          writer.String (char_vector.c_str ());
+          write_strings (writer, data, length, stride, length);
+          return;
         }
-      else
-        for (octave_idx_type i = 0; i < array.numel () / original_dims(1); ++i)
-          {
-            std::string char_vector = "";
-            for (octave_idx_type k = 0; k < original_dims(1); ++k)
-              char_vector += array(i * original_dims(1) + k);
-            writer.String (char_vector.c_str ());
-          }
+
+      // Place an opening and a closing bracket (represents a dimension)
+      // for every dimension that equals 1 till we reach the 2-D vector
+      for (int i = level; i < ndims - 1; ++i)
+        writer.StartArray ();
+      write_strings (writer, data, length, stride, original_dims(1));
+      for (int i = level; i < ndims - 1; ++i)
+        writer.EndArray ();
+      return;
     }
+
+  writer.StartArray ();
+  // We place an opening and a closing bracket for each dimension
+  // that equals 1 to preserve the number of dimensions when decoding
+  // the array after encoding it.
+  if (original_dims (level) == 1 && level != 1)
+    encode_strided_string (writer, array, strides, dims, offset, level + 1);
   else
     {
-      octave_idx_type idx;
-      octave_idx_type ndims = array.ndims ();
-      dim_vector dims = array.dims ();
+      // The second dimension contains the number of the chars in the char
+      // vector. We want to treat them as a one object, so the part is split
+      // along the first other dimension that isn't 1.
+      int idx = (dims[0] != 1 ? 0 : 2);
+      while (dims[idx] == 1)
+        idx++;
+
+      octave_idx_type n = dims[idx];
+      dims[idx] = 1;
+      for (octave_idx_type k = 0; k < n; ++k)
+        encode_strided_string (writer, array, strides, dims,
+                               offset + k * strides[idx], level + 1);
+      dims[idx] = n;
+    }
+  writer.EndArray ();
+}
 
-      // In this case, we already have a vector. So,  we transform it to 2-D
-      // vector in order to be detected by "isvector" in the recursive call
-      if (dims.num_ones () == ndims - 1)
-      {
-        // Handle the special case when the input is a vector with more than
-        // 2 dimensions (e.g. cat (8, ['a'], ['c'])). In this case, we don't
-        // add dimension brackets and treat it as if it is a vector
-        if (level != 0)
-          // Place an opening and a closing bracket (represents a dimension)
-          // for every dimension that equals 1 till we reach the 2-D vector
-          for (int i = level; i < ndims - 1; ++i)
-            writer.StartArray ();
-
-        encode_string (writer, array.as_row (), original_dims, level);
-
-        if (level != 0)
-          for (int i = level; i < ndims - 1; ++i)
-            writer.EndArray ();
-      }
-      else
-        {
-          // We place an opening and a closing bracket for each dimension
-          // that equals 1 to preserve the number of dimensions when decoding
-          // the array after encoding it.
-          if (original_dims (level) == 1 && level != 1)
-          {
-            writer.StartArray ();
-            encode_string (writer, array, original_dims, level + 1);
-            writer.EndArray ();
-          }
-          else
-            {
-              // The second dimension contains the number of the chars in
-              // the char vector. We want to treat them as a one object,
-              // so we replace it with 1
-              dims(1) = 1;
-
-              for (idx = 0; idx < ndims; ++idx)
-                if (dims(idx) != 1)
-                  break;
-              // Create the dimensions that will be used to call "num2cell"
-              // We called "num2cell" to divide the array to smaller sub arrays
-              // in order to encode it recursively.
-              // The recursive encoding is necessary to support encoding of
-              // higher-dimensional arrays.
-              RowVector conversion_dims;
-              conversion_dims.resize (ndims - 1);
-              for (octave_idx_type i = 0; i < idx; ++i)
-                conversion_dims(i) = i + 1;
-              for (octave_idx_type i = idx ; i < ndims - 1; ++i)
-                conversion_dims(i) = i + 2;
-
-              octave_value_list args (obj);
-              args.append (conversion_dims);
-
-              Cell sub_arrays = Fnum2cell (args)(0).cell_value ();
-
-              writer.StartArray ();
-
-              for (octave_idx_type i = 0; i < sub_arrays.numel (); ++i)
-                encode_string (writer, sub_arrays(i), original_dims,
-                               level + 1);
-
-              writer.EndArray ();
-            }
-        }
+//! Encodes character vectors and arrays into JSON strings.  Each string is
+//! written from the data of the array, gathering its characters with the
+//! stride of the second dimension if they aren't contiguous.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param obj character vectors or character arrays.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_value obj ("foo");
+//! encode_string (writer, obj);
+//! @endcode
+
+template <typename T> void
+encode_string (T& writer, const octave_value& obj)
+{
+  charNDArray array = obj.char_array_value ();
+  if (array.isempty ())
+    {
+      writer.String ("");
+      return;
+    }
+
+  const dim_vector& dims = array.dims ();
+  int ndims = dims.ndims ();
+  std::vector<octave_idx_type> strides (ndims, 1);
+  std::vector<octave_idx_type> part_dims (ndims);
+  part_dims[0] = dims(0);
+  for (int i = 1; i < ndims; ++i)
+    {
+      strides[i] = strides[i-1] * dims(i-1);
+      part_dims[i] = dims(i);
     }
+  encode_strided_string (writer, array, strides, part_dims, 0);
 }
 
 //! Encodes a struct Octave value into a JSON object or a JSON array depending
-//! on the type of the struct (scalar struct or struct array.)
+//! on the type of the struct (scalar struct or struct array.)  The values
+//! are read from the column of each field, and the keys are escaped once
+//! and written as raw JSON for every element.
 //!
 //! @param writer RapidJSON's writer that is responsible for generating json.
 //! @param obj struct Octave value.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
+//! @param options Encoding options with their values.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! octave_value obj (octave_map ());
-//! encode_struct (writer, obj,true);
+//! encode_options options;
+//! encode_struct (writer, obj, options);
 //! @endcode
 
 template <typename T> void
-encode_struct (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
+encode_struct (T& writer, const octave_value& obj,
+               const encode_options& options)
 {
-  octave_map struct_array = obj.map_value ();
+  const octave_map struct_array = obj.map_value ();
   octave_idx_type numel = struct_array.numel ();
   string_vector keys = struct_array.keys ();
+  octave_idx_type n_keys = keys.numel ();
+
+  // The escaped keys are stored one after the other in one string
+  std::string key_bytes;
+  std::vector<std::size_t> key_ends (n_keys);
+  std::vector<const Cell *> columns (n_keys);
+  for (octave_idx_type k = 0; k < n_keys; ++k)
+    {
+      escape_string (keys(k).data (), keys(k).length (), key_bytes);
+      key_ends[k] = key_bytes.size ();
+      columns[k] = &struct_array.contents (k);
+    }
 
   if (numel > 1)
     writer.StartArray ();
@@ -211,10 +853,13 @@ encode_struct (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
   for (octave_idx_type i = 0; i < numel; ++i)
     {
       writer.StartObject ();
-      for (octave_idx_type k = 0; k < keys.numel (); ++k)
+      std::size_t key_start = 0;
+      for (octave_idx_type k = 0; k < n_keys; ++k)
         {
-          writer.Key (keys(k).c_str ());
-          encode (writer, struct_array(i).getfield (keys(k)), ConvertInfAndNaN);
+          writer.RawValue (key_bytes.data () + key_start,
+                           key_ends[k] - key_start, rapidjson::kStringType);
+          key_start = key_ends[k];
+          encode (writer, (*columns[k])(i), options);
         }
       writer.EndObject ();
     }
@@ -227,166 +872,241 @@ encode_struct (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
 //!
 //! @param writer RapidJSON's writer that is responsible for generating json.
 //! @param obj Cell Octave value.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
+//! @param options Encoding options with their values.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! octave_value obj (cell ());
-//! encode_cell (writer, obj,true);
+//! encode_options options;
+//! encode_cell (writer, obj, options);
 //! @endcode
 
 template <typename T> void
-encode_cell (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
+encode_cell (T& writer, const octave_value& obj, const encode_options& options)
 {
   Cell cell = obj.cell_value ();
 
   writer.StartArray ();
 
   for (octave_idx_type i = 0; i < cell.numel (); ++i)
-    encode (writer, cell(i), ConvertInfAndNaN);
+    encode (writer, cell(i), options);
 
   writer.EndArray ();
 }
 
-//! Encodes a numeric or logical Octave array into a JSON array
+//! Encodes the elements of a numeric or logical array that start at an
+//! offset of its data, with one JSON array per dimension starting at a
+//! level.  The sub arrays are found with the strides of the dimensions in
+//! the data of the original array, so nothing is copied.
 //!
 //! @param writer RapidJSON's writer that is responsible for generating json.
-//! @param obj numeric or logical Octave array.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
-//! @param original_dims The original dimensions of the array being encoded.
-//! @param level The level of recursion for the function.
+//! @param data The data of the whole array.
+//! @param dims The dimensions of the whole array.
+//! @param strides The distance in the data between two consecutive elements
+//! of each dimension.
+//! @param level The first dimension to encode.
+//! @param offset The index in the data of the first element.
+//! @param options Encoding options with their values.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
-//! octave_value obj (NDArray ());
-//! encode_array (writer, obj,true);
+//! NDArray array (dim_vector (2, 3, 4), 1);
+//! std::vector<octave_idx_type> strides ({1, 2, 6});
+//! encode_options options;
+//! encode_strided (writer, array.data (), array.dims (), strides, 0, 0,
+//!                 options);
 //! @endcode
 
-template <typename T> void
-encode_array (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN,
-              const dim_vector& original_dims, int level = 0)
+template <typename T, typename E> void
+encode_strided (T& writer, const E *data, const dim_vector& dims,
+                const std::vector<octave_idx_type>& strides, int level,
+                octave_idx_type offset, const encode_options& options)
+{
+  int ndims = dims.ndims ();
+
+  // The dimensions before the level are already split, so if only one of
+  // the remaining dimensions isn't 1, the elements are a vector
+  int dim = -1;
+  int n_dims = 0;
+  for (int i = level; i < ndims; ++i)
+    if (dims(i) != 1)
+      {
+        dim = i;
+        n_dims++;
+      }
+
+  if (n_dims <= 1)
+    {
+      // Place an opening and a closing bracket (represents a dimension)
+      // for every remaining dimension, the innermost one holds the vector
+      for (int i = level; i < ndims; ++i)
+        writer.StartArray ();
+
+      octave_idx_type n = (dim < 0 ? 1 : dims(dim));
+      octave_idx_type stride = (dim < 0 ? 0 : strides[dim]);
+      for (octave_idx_type k = 0; k < n; ++k)
+        write_element (writer, data[offset + k * stride], options);
+
+      for (int i = level; i < ndims; ++i)
+        writer.EndArray ();
+      return;
+    }
+
+  // We place an opening and a closing bracket for each dimension that
+  // equals 1 to preserve the number of dimensions when decoding the array
+  // after encoding it.  Other dimensions are split into their sub arrays.
+  writer.StartArray ();
+  for (octave_idx_type k = 0; k < dims(level); ++k)
+    encode_strided (writer, data, dims, strides, level + 1,
+                    offset + k * strides[level], options);
+  writer.EndArray ();
+}
+
+//! Encodes a typed numeric or logical array into a JSON array.  Vectors,
+//! including N-D arrays with a single dimension that isn't 1, are encoded
+//! into a flat JSON array and other arrays into nested JSON arrays with
+//! @ref encode_strided.  The elements are read from the data of the array
+//! with their own type.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param array numeric or logical array, e.g. @c int32NDArray.
+//! @param options Encoding options with their values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! int32NDArray array (dim_vector (2, 2), octave_int32 (7));
+//! encode_options options;
+//! encode_typed_array (writer, array, options);
+//! @endcode
+
+template <typename T, typename A> void
+encode_typed_array (T& writer, const A& array, const encode_options& options)
 {
-  NDArray array = obj.array_value ();
+  const dim_vector& dims = array.dims ();
+  int ndims = dims.ndims ();
+  auto data = array.data ();
+
   if (array.isempty ())
     {
       writer.StartArray ();
       writer.EndArray ();
     }
-  else if (array.isvector ())
+  else if (dims.num_ones () >= ndims - 1)
     {
+      // Handle the special case when the input is a vector with more than
+      // 2 dimensions (e.g. ones ([1 1 1 1 1 6])). In this case, we don't
+      // add dimension brackets and treat it as if it is a vector
       writer.StartArray ();
       for (octave_idx_type i = 0; i < array.numel (); ++i)
-        {
-          if (obj.islogical ())
-            encode_numeric (writer, bool (array(i)), ConvertInfAndNaN);
-          else
-            encode_numeric (writer, array(i), ConvertInfAndNaN);
-        }
+        write_element (writer, data[i], options);
       writer.EndArray ();
     }
   else
     {
-      octave_idx_type idx;
-      octave_idx_type ndims = array.ndims ();
-      dim_vector dims = array.dims ();
-
-      // In this case, we already have a vector. So,  we transform it to 2-D
-      // vector in order to be detected by "isvector" in the recursive call
-      if (dims.num_ones () == ndims - 1)
-        {
-          // Handle the special case when the input is a vector with more than
-          // 2 dimensions (e.g. ones ([1 1 1 1 1 6])). In this case, we don't
-          // add dimension brackets and treat it as if it is a vector
-          if (level != 0)
-            // Place an opening and a closing bracket (represents a dimension)
-            // for every dimension that equals 1 till we reach the 2-D vector
-            for (int i = level; i < ndims - 1; ++i)
-              writer.StartArray ();
-
-          encode_array (writer, array.as_row (), ConvertInfAndNaN,
-                        original_dims);
-
-          if (level != 0)
-            for (int i = level; i < ndims - 1; ++i)
-              writer.EndArray ();
-        }
-      else
-        {
-          // We place an opening and a closing bracket for each dimension
-          // that equals 1 to preserve the number of dimensions when decoding
-          // the array after encoding it.
-          if (original_dims (level) == 1)
-          {
-            writer.StartArray ();
-            encode_array (writer, array, ConvertInfAndNaN,
-                          original_dims, level + 1);
-            writer.EndArray ();
-          }
-          else
-            {
-              for (idx = 0; idx < ndims; ++idx)
-                if (dims(idx) != 1)
-                  break;
-
-              // Create the dimensions that will be used to call "num2cell"
-              // We called "num2cell" to divide the array to smaller sub arrays
-              // in order to encode it recursively.
-              // The recursive encoding is necessary to support encoding of
-              // higher-dimensional arrays.
-              RowVector conversion_dims;
-              conversion_dims.resize (ndims - 1);
-              for (octave_idx_type i = 0; i < idx; ++i)
-                conversion_dims(i) = i + 1;
-              for (octave_idx_type i = idx ; i < ndims - 1; ++i)
-                conversion_dims(i) = i + 2;
-
-              octave_value_list args (obj);
-              args.append (conversion_dims);
-
-              Cell sub_arrays = Fnum2cell (args)(0).cell_value ();
-
-              writer.StartArray ();
-
-              for (octave_idx_type i = 0; i < sub_arrays.numel (); ++i)
-                encode_array (writer, sub_arrays(i), ConvertInfAndNaN,
-                              original_dims, level + 1);
-
-              writer.EndArray ();
-            }
-        }
+      std::vector<octave_idx_type> strides (ndims, 1);
+      for (int i = 1; i < ndims; ++i)
+        strides[i] = strides[i-1] * dims(i-1);
+      encode_strided (writer, data, dims, strides, 0, 0, options);
     }
 }
 
+//! Encodes a numeric or logical Octave array into a JSON array.  The array
+//! is encoded with the kernel of its class, so integers and singles aren't
+//! converted to doubles first.
+//!
+//! @param writer RapidJSON's writer that is responsible for generating json.
+//! @param obj numeric or logical Octave array.
+//! @param options Encoding options with their values.
+//!
+//! @b Example:
+//!
+//! @code{.cc}
+//! octave_value obj (NDArray ());
+//! encode_options options;
+//! encode_array (writer, obj, options);
+//! @endcode
+
+template <typename T> void
+encode_array (T& writer, const octave_value& obj,
+              const encode_options& options)
+{
+  if (obj.islogical ())
+    encode_typed_array (writer, obj.bool_array_value (), options);
+  else if (obj.is_single_type ())
+    encode_typed_array (writer, obj.float_array_value (), options);
+  else if (obj.is_int8_type ())
+    encode_typed_array (writer, obj.int8_array_value (), options);
+  else if (obj.is_int16_type ())
+    encode_typed_array (writer, obj.int16_array_value (), options);
+  else if (obj.is_int32_type ())
+    encode_typed_array (writer, obj.int32_array_value (), options);
+  else if (obj.is_int64_type ())
+    encode_typed_array (writer, obj.int64_array_value (), options);
+  else if (obj.is_uint8_type ())
+    encode_typed_array (writer, obj.uint8_array_value (), options);
+  else if (obj.is_uint16_type ())
+    encode_typed_array (writer, obj.uint16_array_value (), options);
+  else if (obj.is_uint32_type ())
+    encode_typed_array (writer, obj.uint32_array_value (), options);
+  else if (obj.is_uint64_type ())
+    encode_typed_array (writer, obj.uint64_array_value (), options);
+  else
+    encode_typed_array (writer, obj.array_value (), options);
+}
+
 //! Encodes any Octave object. This function only serves as an interface
 //! by choosing which function to call from the previous functions.
 //!
 //! @param writer RapidJSON's writer that is responsible for generating json.
 //! @param obj any @ref octave_value that is supported.
-//! @param ConvertInfAndNaN @c bool that converts @c Inf and @c NaN to @c null.
+//! @param options Encoding options with their values.
 //!
 //! @b Example:
 //!
 //! @code{.cc}
 //! octave_value obj (true);
-//! encode (writer, obj,true);
+//! encode_options options;
+//! encode (writer, obj, options);
 //! @endcode
 
 template <typename T> void
-encode (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
+encode (T& writer, const octave_value& obj, const encode_options& options)
 {
+  encode_stats *stats = options.stats;
   if (obj.is_real_scalar ())
-    encode_numeric (writer, obj, ConvertInfAndNaN);
+    {
+      if (stats)
+        stats->scalars++;
+      encode_numeric (writer, obj, options);
+    }
   // As I checked for scalars, this will detect numeric & logical arrays
   else if (obj.isnumeric () || obj.islogical ())
-    encode_array (writer, obj, ConvertInfAndNaN, obj.dims ());
+    {
+      if (stats)
+        stats->arrays++;
+      encode_array (writer, obj, options);
+    }
   else if (obj.is_string ())
-    encode_string (writer, obj, obj.dims ());
+    {
+      if (stats)
+        stats->strings++;
+      encode_string (writer, obj);
+    }
   else if (obj.isstruct ())
-    encode_struct (writer, obj, ConvertInfAndNaN);
+    {
+      if (stats)
+        stats->structs++;
+      encode_struct (writer, obj, options);
+    }
   else if (obj.iscell ())
-    encode_cell (writer, obj, ConvertInfAndNaN);
+    {
+      if (stats)
+        stats->cells++;
+      encode_cell (writer, obj, options);
+    }
   else if (obj.class_name () == "containers.Map")
     // To extract the data in containers.Map, Convert it to a struct.
     // The struct will have a "map" field that its value is a struct that
@@ -394,27 +1114,33 @@ encode (T& writer, const octave_value& obj, const bool& ConvertInfAndNaN)
     // In order to convert it we will need to disable the
     // "Octave:classdef-to-struct" warning and re-enable it.
     {
+      if (stats)
+        stats->structs++;
       set_warning_state ("Octave:classdef-to-struct", "off");
       encode_struct (writer, obj.scalar_map_value ().getfield ("map"),
-                     ConvertInfAndNaN);
+                     options);
       set_warning_state ("Octave:classdef-to-struct", "on");
     }
   else if (obj.isobject ())
     {
+      if (stats)
+        stats->structs++;
       set_warning_state ("Octave:classdef-to-struct", "off");
-      encode_struct (writer, obj.scalar_map_value (), ConvertInfAndNaN);
+      encode_struct (writer, obj.scalar_map_value (), options);
       set_warning_state ("Octave:classdef-to-struct", "on");
     }
   else
     error ("jsonencode: Unsupported type.");
 }
 
-DEFUN_DLD (jsonencode, args, ,
+DEFUN_DLD (jsonencode, args, nargout,
            doc: /* -*- texinfo -*-
 @deftypefn  {} {@var{json} =} jsonencode (@var{object})
 @deftypefnx {} {@var{json} =} jsonencode (@var{object}, "ConvertInfAndNaN", @var{conv})
 @deftypefnx {} {@var{json} =} jsonencode (@var{object}, "PrettyWriter", @var{pretty})
+@deftypefnx {} {@var{json} =} jsonencode (@var{object}, "SignificantDigits", @var{digits})
 @deftypefnx {} {@var{json} =} jsonencode (@var{object}, @dots{})
+@deftypefnx {} {[@var{json}, @var{stats}] =} jsonencode (@dots{})
 
 Encode Octave's data types into JSON text.
 
@@ -431,6 +1157,20 @@ If the value of the option @qcode{"PrettyWriter"} is true, the output text will
 have indentations and line feeds. If it is false, the output will be condensed
 and without any white-spaces. The default value for this option is false.
 
+The option @qcode{"SignificantDigits"} sets the number of significant digits,
+from 1 to 17, of the numbers that aren't integers.  Fewer digits give a
+smaller output that isn't read back as exactly the same numbers.  The default
+value for this option is @code{Inf}: each number is written with the fewest
+digits that are read back as the same number, which are computed for singles
+as singles.
+
+If the second output @var{stats} is requested, it is a struct of counters of
+the call: the time in seconds (@qcode{"total_time"}), the bytes of
+@var{json}, the number of encoded scalars, numeric and logical arrays,
+character arrays, structs and cells, and the number of numbers written
+with decimals.  Without @var{stats}, no counter is
+collected.
+
 -NOTES:
 @itemize @bullet
 @item
@@ -523,6 +1263,11 @@ jsonencode ([1 NaN; 3 4], "ConvertInfAndNaN", false)
 @result{}  [[1,NaN],[3,4]]
 @end group
 
+@group
+jsonencode ([pi, 0.1], "SignificantDigits", 4)
+@result{}  [3.142,0.1]
+@end group
+
 @group
 jsonencode ([true; false], "ConvertInfAndNaN", false, "PrettyWriter", true)
 @result{} ans = [
@@ -563,30 +1308,52 @@ jsonencode (containers.Map({'foo'; 'bar'; 'baz'}, [1, 2, 3]))
 #if defined (HAVE_RAPIDJSON)
 
   int nargin = args.length ();
-  // jsonencode has two options 'ConvertInfAndNaN' and 'PrettyWriter'
-  if (! (nargin == 1 || nargin == 3 || nargin == 5))
+  // The options must be in pairs
+  if (! (nargin % 2))
     print_usage ();
 
   // Initialize options with their default values
-  bool ConvertInfAndNaN = true;
+  encode_options options;
   bool PrettyWriter = false;
 
   for (octave_idx_type i = 1; i < nargin; ++i)
     {
       if (! args(i).is_string ())
         error ("jsonencode: Option must be character vector");
-      if (! args(i+1).is_bool_scalar ())
-        error ("jsonencode: Value for options must be logical scalar");
 
       std::string option_name = args(i++).string_value ();
+      if (octave::string::strcmpi (option_name, "SignificantDigits"))
+        {
+          double digits = args(i).xdouble_value ("jsonencode: Value for "
+                                                 "\'SignificantDigits\' must "
+                                                 "be numeric");
+          if (std::isinf (digits) && digits > 0)
+            options.significant_digits = 0;
+          else if (digits >= 1 && digits <= 17
+                   && digits == octave::math::round (digits))
+            options.significant_digits = digits;
+          else
+            error ("jsonencode: Value for \'SignificantDigits\' must be an "
+                   "integer from 1 to 17 or Inf");
+          continue;
+        }
+
+      if (! args(i).is_bool_scalar ())
+        error ("jsonencode: Value for options must be logical scalar");
       if (octave::string::strcmpi(option_name, "ConvertInfAndNaN"))
-        ConvertInfAndNaN = args(i).bool_value ();
+        options.convert_inf_and_nan = args(i).bool_value ();
       else if (octave::string::strcmpi(option_name, "PrettyWriter"))
         PrettyWriter = args(i).bool_value ();
       else
-        error ("jsonencode: Valid options are \'ConvertInfAndNaN\'"
-               " and \'PrettyWriter\'");
+        error ("jsonencode: Valid options are \'ConvertInfAndNaN\',"
+               " \'PrettyWriter\' and \'SignificantDigits\'");
     }
+  // The counters are only collected if they are requested
+  encode_stats stats;
+  if (nargout > 1)
+    options.stats = &stats;
+  auto start = std::chrono::steady_clock::now ();
+
   rapidjson::StringBuffer json;
   if (PrettyWriter)
     // In order to use the "PrettyWriter" option, you must use the development
@@ -595,17 +1362,23 @@ jsonencode (containers.Map({'foo'; 'bar'; 'baz'}, [1, 2, 3]))
       rapidjson::PrettyWriter<rapidjson::StringBuffer, rapidjson::UTF8<>,
                               rapidjson::UTF8<>, rapidjson::CrtAllocator,
                               rapidjson::kWriteNanAndInfFlag> writer (json);
-      encode (writer, args(0), ConvertInfAndNaN);
+      encode (writer, args(0), options);
     }
   else
     {
       rapidjson::Writer<rapidjson::StringBuffer, rapidjson::UTF8<>,
                         rapidjson::UTF8<>, rapidjson::CrtAllocator,
                         rapidjson::kWriteNanAndInfFlag> writer (json);
-      encode (writer, args(0), ConvertInfAndNaN);
+      encode (writer, args(0), options);
     }
 
-  return octave_value (json.GetString ());
+  if (nargout < 2)
+    return octave_value (json.GetString ());
+
+  stats.total_time = std::chrono::duration<double> (
+                       std::chrono::steady_clock::now () - start).count ();
+  stats.bytes = json.GetSize ();
+  return ovl (json.GetString (), stats.map_value ());
 
 #else
 
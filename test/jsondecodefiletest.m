@@ -0,0 +1,44 @@
+% test jsondecodefile
+
+%% Test 1: decode a file with the same result as jsondecode
+
+%!test
+%! json = '{"a": [1, 2, null], "b": [{"i d": 1}, {"i d": 2}], "c": "foo"}';
+%! filename = tempname ();
+%! fid = fopen (filename, 'w');
+%! fputs (fid, json);
+%! fclose (fid);
+%! unwind_protect
+%!   assert (isequaln (jsondecode (json), jsondecodefile (filename)));
+%!   assert (isequaln (jsondecode (json), ...
+%!                     jsondecodefile (filename, 'Streaming', true)));
+%! unwind_protect_cleanup
+%!   unlink (filename);
+%! end_unwind_protect
+
+%% Test 2: forward the options of jsondecode
+
+%!test
+%! filename = tempname ();
+%! fid = fopen (filename, 'w');
+%! fputs (fid, '{"1a": {"1*a": 1}}');
+%! fclose (fid);
+%! unwind_protect
+%!   exp = struct ('n1a', struct ('n1a', 1));
+%!   act = jsondecodefile (filename, 'ReplacementStyle', 'delete', 'Prefix', 'n');
+%!   assert (isequal (exp, act));
+%! unwind_protect_cleanup
+%!   unlink (filename);
+%! end_unwind_protect
+
+%% Test 3: errors
+
+%!error <unable to open file> jsondecodefile (tempname ())
+%!error <The document is empty>
+%! filename = tempname ();
+%! fclose (fopen (filename, 'w'));
+%! unwind_protect
+%!   jsondecodefile (filename);
+%! unwind_protect_cleanup
+%!   unlink (filename);
+%! end_unwind_protect
@@ -36,6 +36,13 @@
 
 %!assert (isequal ('hello there', jsondecode ('"hello there"')));
 
+% escaped characters are decoded in place
+%!test
+%! json = '{"k\u0065y": ["a\"b", "c\\d", ""]}';
+%! exp  = struct ('key', {{'a"b'; 'c\d'; ''}});
+%! assert (isequal (exp, jsondecode (json)));
+%! assert (isequal (exp, jsondecode (json, "Streaming", true)));
+
 %% Test 3: decode Array of Booleans, Numbers and Strings values
 %!test
 %! json = '[true, true, false, true]';
@@ -115,6 +122,13 @@
 %! act  = jsondecode (json);
 %! assert (isequal (exp, act));
 
+%!test
+%! json = '[[[true, false]], [[false, true]]]';
+%! exp  = cat (3, [true; false], [false; true]);
+%! act  = jsondecode (json);
+%! assert (isequal (exp, act));
+%! assert (islogical (act));
+
 % If they have different dimensions -> transform to a cell array
 % extracted from JSONio
 %!test
@@ -136,6 +150,20 @@
 %! act  = jsondecode (json);
 %! assert (isequal (exp, act));
 
+% sub arrays that are decoded into arrays of the same size are combined
+%!test
+%! json = '[[1, 2], [[3], [4]]]';
+%! exp  = [1, 2; 3, 4];
+%! act  = jsondecode (json);
+%! assert (isequal (exp, act));
+
+%!test
+%! json = '["a", [[1, 2], [3, 4]], [[1, 2], [3]], [[true], [1]]]';
+%! exp  = {'a'; [1, 2; 3, 4]; {[1; 2]; 3}; {true; 1}};
+%! act  = jsondecode (json);
+%! assert (isequal (exp, act));
+%! assert (isequal (exp, jsondecode (json, "Streaming", true)));
+
 %% Test 4: decode JSON objects
 
 % check the decoding of Boolean, Number and String values inside an object
@@ -386,6 +414,13 @@
 %! act  = jsondecode (json);
 %! assert (isequaln (exp, act));
 
+% objects with duplicate keys and keys that differ only before makeValidName
+%!test
+%! json = '[{"a":1,"a":2,"b c":3},{"a":4,"a":5,"bC":6},{"a":7,"bC":8}]';
+%! exp  = struct ('a', {2; 5; 7}, 'bC', {3; 6; 8});
+%! act  = jsondecode (json);
+%! assert (isequal (exp, act));
+
 %% Test 6: decode Array of different JSON data types
 %!test
 %! json = ['[null, true, Inf, 2531.023, "hello there", ', ...
@@ -506,3 +541,340 @@
 %! exp  = struct ('cell_array', {{struct('x_1a', 1, 'b_1', 2); struct('x_1a', 3, 'b_2', 4)}});
 %! act  = jsondecode (json, "ReplacementStyle", "underscore", "Prefix", "x_");
 %! assert (isequal (exp, act));
+
+% Check the conversion of keywords and whitespace in keys
+%!test
+%! json = '{"if": 1, "foo bar": 2, "  end": 3}';
+%! exp  = struct ('xIf', 1, 'fooBar', 2, 'xEnd', 3);
+%! act  = jsondecode (json);
+%! assert (isequal (exp, act));
+
+%!error <Valid values for 'ReplacementStyle'> jsondecode ('{}', 'ReplacementStyle', 'foo')
+%!error <Invalid 'Prefix' value> jsondecode ('{}', 'Prefix', '1x')
+
+%% Test 8: decode with the streaming parser
+
+%!test
+%! json = ['{"a": [1, null, 3], "b": [true, false], "c": ["x", null, 2], ', ...
+%!         '"d": [[1, 2], [3, 4]], "e": [[1, 2], [3]], "f": [{"x": 1}, {"x": 2}], ', ...
+%!         '"g": [{"x": 1}, {"y": 2}], "h": [1, {"x": 1}], "i": [], "j": null}'];
+%! exp  = jsondecode (json);
+%! act  = jsondecode (json, "Streaming", true);
+%! assert (isequaln (exp, act));
+
+%!test
+%! json = '[[[1, 2], [3, 4]], [[5, 6], [7, 8]]]';
+%! exp  = cat (3, [1, 3; 5, 7], [2, 4; 6, 8]);
+%! act  = jsondecode (json, "Streaming", true);
+%! assert (isequal (exp, act));
+
+%!error <Parse error at offset 5> jsondecode ('[1, 2', "Streaming", true)
+
+%% Test 9: decode JSON Lines
+
+%!test
+%! json = sprintf ('{"a": 1, "b": "x"}\n{"b": "y", "a": 2}\n\n{"a": 3, "b": null}\n');
+%! exp  = struct ('a', {1; 2; 3}, 'b', {'x'; 'y'; []});
+%! assert (isequal (exp, jsondecode (json, "JSONLines", true)));
+%! assert (isequal (exp, jsondecode (json, "JSONLines", true, "Streaming", true)));
+
+%!test
+%! json = sprintf ('{"a": 1}\n{"b": 2}\n[1, 2]\n');
+%! exp  = {struct('a', 1); struct('b', 2); [1; 2]};
+%! assert (isequal (exp, jsondecode (json, "JSONLines", true)));
+%! assert (isequal (exp, jsondecode (json, "JSONLines", true, "Streaming", true)));
+
+%!test
+%! json = sprintf ('{"a": 1}\n{"a": 2}\n{"a": 3}\n');
+%! exp  = {struct('a', {1; 2}); struct('a', 3)};
+%! act  = jsondecode (json, "JSONLines", true, "BatchSize", 2);
+%! assert (isequal (exp, act));
+
+%!test
+%! json = sprintf ('{"a": 1}\n{"a": 2}\n{"a": 3}\n');
+%! act  = evalc (['jsondecode (json, "JSONLines", true, "BatchSize", 2, ', ...
+%!                '"BatchFcn", @(batch) printf ("%d\n", numel (batch)));']);
+%! assert (act, sprintf ("2\n1\n"));
+
+%!assert (jsondecode ('', "JSONLines", true), [])
+
+%!error <Parse error at offset 10> jsondecode (sprintf ('{"a": 1}\n{'), "JSONLines", true)
+%!error <'BatchSize' must be a positive integer> jsondecode ('1', "JSONLines", true, "BatchSize", 0)
+%!error <require 'JSONLines'> jsondecode ('1', "BatchSize", 2)
+%!error <separated by newlines at offset 8> jsondecode ('{"a":1} {"a":2}', "JSONLines", true)
+%!error <separated by newlines at offset 2> jsondecode ('1 2', "JSONLines", true, "Streaming", true)
+
+%% Test 10: decode a cellstr
+
+%!test
+%! jsons = {'{"a b": 1}', '[1, 2]'; '"x"', '{"a b": [true, false]}'};
+%! exp   = cellfun (@jsondecode, jsons, "UniformOutput", false);
+%! assert (isequal (exp, jsondecode (jsons)));
+%! assert (isequal (exp, jsondecode (jsons, "Threads", 3)));
+%! assert (isequal (exp, jsondecode (jsons, "Streaming", true)));
+
+%!test
+%! jsons = repmat ({'{"1": [1, 2, 3], "b": {"c": null}}'}, 50, 1);
+%! act   = jsondecode (jsons, "Threads", 4, "Prefix", "n");
+%! assert (size (act), [50, 1]);
+%! assert (isequaln (act{50}, struct ('n1', [1; 2; 3], 'b', struct ('c', []))));
+
+%!assert (jsondecode (cell (0, 1)), cell (0, 1))
+
+%!error <Parse error in element 2 at offset 2> jsondecode ({'1', '[1'})
+%!error <Parse error in element 2 at offset 2> jsondecode ({'1', '[1', '2'}, "Threads", 2)
+%!error <'Threads' must be a positive integer> jsondecode ({'1'}, "Threads", 1.5)
+%!error <'Threads' must be a positive integer> jsondecode ({'1'}, "Threads", Inf)
+
+%% Test 11: decode numbers into the class chosen by "NumericType"
+
+%!test
+%! json = '{"id": 9007199254740993, "n": [1, 2, 3], "x": [1.5, 2], "m": [[1, 2], [3, 4]], "z": [1, null]}';
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "NumericType", "int64", "Streaming", streaming);
+%!   assert (act.id, int64 (9007199254740992) + 1);
+%!   assert (act.n, int64 ([1; 2; 3]));
+%!   assert (act.x, [1.5; 2]);
+%!   assert (act.m, int64 ([1, 2; 3, 4]));
+%!   assert (act.z, [1; NaN]);
+%! endfor
+
+%!test
+%! json = '[[1, 2], [3, 4], [5, 2147483648]]';
+%! for streaming = [false, true]
+%!   assert (jsondecode (json, "NumericType", "auto", "Streaming", streaming),
+%!           int64 ([1, 2; 3, 4; 5, 2147483648]));
+%!   assert (jsondecode (json, "NumericType", "int32", "Streaming", streaming),
+%!           [1, 2; 3, 4; 5, 2147483648]);
+%!   assert (jsondecode ('[1, 2, 3]', "NumericType", "auto", "Streaming", streaming),
+%!           int32 ([1; 2; 3]));
+%! endfor
+
+%!test
+%! json = '{"a": [1.5, null], "b": 2, "c": [1, "x"]}';
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "NumericType", "single", "Streaming", streaming);
+%!   assert (act.a, single ([1.5; NaN]));
+%!   assert (act.b, single (2));
+%!   assert (act.c, {single(1); 'x'});
+%! endfor
+
+%!test
+%! act = jsondecode ('[1, "x", 2.5]', "NumericType", "int32");
+%! assert (act, {int32(1); 'x'; 2.5});
+
+%!error <Valid values for 'NumericType'> jsondecode ('1', "NumericType", "uint8")
+
+%% Test 12: decode only the values selected by "Select"
+
+%!test
+%! json = ['{"results": {"metrics": [[1, 2], [3, 4]], "a/b": {"~c": "x"}}, ', ...
+%!         '"items": [{"id": 1}, {"id": 2, "tags": ["p", "q"]}], "rest": [1, {"r": null}]}'];
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "Select", "/results/metrics", "Streaming", streaming);
+%!   assert (act, [1, 2; 3, 4]);
+%!   act = jsondecode (json, "Select", "results.metrics.1", "Streaming", streaming);
+%!   assert (act, [3; 4]);
+%!   act = jsondecode (json, "Select", {"/results/a~1b/~0c", "items.1"; "", "items.1.tags.0"},
+%!                     "Streaming", streaming);
+%!   assert (act, {"x", struct("id", 2, "tags", {{"p"; "q"}}); jsondecode(json), "p"});
+%! endfor
+
+%!test
+%! json = sprintf ('{"a": {"b": 1}, "c": 2}\n{"a": {"b": 3}}\n');
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "JSONLines", true, "Select", "a.b", "Streaming", streaming);
+%!   assert (act, {1; 3});
+%! endfor
+
+%!error <No value at path 'a.c'> jsondecode ('{"a": {"b": 1}}', "Select", "a.c")
+%!error <No value at path '/a/1'> jsondecode ('{"a": [1]}', "Select", "/a/1", "Streaming", true)
+
+%% Test 13: decode deeply nested texts and limit the depth with "MaxDepth"
+
+%!test
+%! n = 5000;
+%! for streaming = [false, true]
+%!   act = jsondecode ([repmat('{"a":', 1, n), '1', repmat('}', 1, n)],
+%!                     "Streaming", streaming);
+%!   for k = 1:n
+%!     act = act.a;
+%!   endfor
+%!   assert (act, 1);
+%!   act = jsondecode ([repmat('["x", ', 1, n), '[1, 2]', repmat(']', 1, n)],
+%!                     "Streaming", streaming);
+%!   for k = 1:n
+%!     assert (act{1}, 'x');
+%!     act = act{2};
+%!   endfor
+%!   assert (act, [1; 2]);
+%!   assert (jsondecode ([repmat('[', 1, n), '1', repmat(']', 1, n)],
+%!                       "Streaming", streaming), 1);
+%! endfor
+
+%!test
+%! json = '{"a": [{"b": [1, 2]}, {"b": [3, 4]}]}';
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "MaxDepth", 4, "Streaming", streaming);
+%!   assert (act, jsondecode (json));
+%!   assert (jsondecode ('[1, 2]', "MaxDepth", 1, "Streaming", streaming), [1; 2]);
+%! endfor
+
+%!error <maximum nesting depth of 3 is exceeded>
+%! jsondecode ('{"a": [{"b": [1, 2]}]}', "MaxDepth", 3)
+%!error <maximum nesting depth of 3 is exceeded>
+%! jsondecode ('{"a": [{"b": [1, 2]}]}', "MaxDepth", 3, "Streaming", true)
+%!error <maximum nesting depth of 2 is exceeded>
+%! jsondecode ('[[[1]]]', "MaxDepth", 2)
+%!error <maximum nesting depth of 1 is exceeded>
+%! jsondecode (sprintf ('[1]\n[[2]]'), "JSONLines", true, "MaxDepth", 1, "Streaming", true)
+%!error <Value for 'MaxDepth' must be a positive integer>
+%! jsondecode ('[1]', "MaxDepth", 1.5)
+
+%% Test 14: share equal strings with "InternStrings" and decode arrays of
+%% strings into codes and categories with "Categorical"
+
+%!test
+%! json = '{"a": ["ok", "fail", "ok"], "b": "ok", "c": ["ok", 1]}';
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "InternStrings", true, "Streaming", streaming);
+%!   assert (act, jsondecode (json));
+%! endfor
+
+%!test
+%! json = '["ok", "fail", "ok", "", "ok"]';
+%! exp.codes = uint32 ([1; 2; 1; 3; 1]);
+%! exp.categories = {"ok"; "fail"; ""};
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "Categorical", true, "Streaming", streaming);
+%!   assert (act, exp);
+%!   assert (act.categories(act.codes), jsondecode (json));
+%! endfor
+
+%!test
+%! json = '{"s": [["a", "b"], ["b"]], "m": ["a", 1, "b"], "e": [], "x": "a"}';
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "Categorical", true, "InternStrings", true,
+%!                     "Streaming", streaming);
+%!   assert (act.s, {struct("codes", uint32 ([1; 2]), "categories", {{"a"; "b"}});
+%!                   struct("codes", uint32 (1), "categories", {{"b"}})});
+%!   assert (act.m, {"a"; 1; "b"});
+%!   assert (act.e, []);
+%!   assert (act.x, "a");
+%! endfor
+
+%!error <Value for 'Categorical' must be logical scalar>
+%! jsondecode ('["a"]', "Categorical", 1)
+
+%% Test 15: reuse the parser arena between calls
+
+%!test
+%! info = __jsondecode_arena__ ();
+%! assert (isfield (info, {"values", "stack", "peak", "limit", "parses"}));
+%! jsondecode ('[1, "a"]');
+%! jsondecode ('{"a": 1}', "Streaming", true);
+%! json = ['[', strjoin(repmat ({'"a"'}, 1, 100000), ','), ']'];
+%! assert (numel (jsondecode (json)), 100000);
+%! assert (numel (jsondecode (json)), 100000);
+%! act = __jsondecode_arena__ ();
+%! assert (act.parses, info.parses + 3);
+%! assert (act.values > info.values);
+%! assert (act.values <= act.limit);
+%! assert (jsondecode ({'[1]', '{"a": "b"}'}), {1, struct("a", "b")});
+
+%!test
+%! n = [20000, 3, 80000, 5];
+%! lines = arrayfun (@(k) jsonencode (struct ("a", 1:k)), n, "UniformOutput", false);
+%! json = strjoin (lines, "\n");
+%! assert (numel (lines{1}) > 65536);
+%! act = jsondecode (json, "JSONLines", true);
+%! assert (size (act), [4, 1]);
+%! for i = 1:numel (n)
+%!   assert (act(i).a, (1:n(i))');
+%! endfor
+%! [act, stats] = jsondecode (json, "JSONLines", true);
+%! assert (stats.dom_nodes, sum (n) + 2 * numel (n));
+
+% a call in a BatchFcn callback parses into a new arena of 64 KiB, which the
+% large records don't fit in
+%!test
+%! json = strjoin (arrayfun (@(k) jsonencode (struct ("a", 1:k)), [20000, 3],
+%!                          "UniformOutput", false), "\n");
+%! stats_of = @() nthargout (2, @jsondecode, json, "JSONLines", true);
+%! check = @(stats) assert (stats.arena_spills > 0 && stats.arena_spill_bytes > 0);
+%! jsondecode ('1', "JSONLines", true, "BatchFcn", @(batch) check (stats_of ()));
+
+%% Test 16: decode flat numeric arrays with the fast path bit-identically
+
+%!test
+%! texts = {'[0.1, -0, -0.0, 1e22, 1e-22, 2.5E+3, 123456789012345678, null]';
+%!          sprintf(' [\n-9223372036854775808,\t9007199254740993, 0.000123 ] ');
+%!          '[0.30000000000000004, 1.7976931348623157e308, 5e-324]';
+%!          '[1, 2, 3]';
+%!          '[null]'};
+%! for i = 1:numel (texts)
+%!   exp = jsondecode (['{"a": ', texts{i}, '}']).a;
+%!   act = jsondecode (texts{i});
+%!   assert (typecast (act, "uint64"), typecast (exp, "uint64"));
+%!   act = jsondecode (texts{i}, "NumericType", "single");
+%!   assert (typecast (act, "uint32"), typecast (single (exp), "uint32"));
+%! endfor
+
+%!test
+%! assert (jsondecode ('[1, true]'), {1; true});
+%! assert (jsondecode ('[1, [2]]'), {1; 2});
+%! assert (jsondecode ('[]'), []);
+%! assert (jsondecode ('[1, 2]', "NumericType", "int32"), int32 ([1; 2]));
+%! [act, stats] = jsondecode (['[1, {"a": [', repmat('0,', 1, 1e5), '0]}]']);
+%! assert (act{2}.a, zeros (1e5 + 1, 1));
+%! assert (stats.fast_numeric_fallbacks, 1);
+
+%!error <Parse error> jsondecode ('[1, 2,]')
+%!error <Parse error> jsondecode ('[01]')
+
+%% Test 17: decode wide objects with duplicate keys
+
+%!test
+%! n = 20000;
+%! keys = arrayfun (@(k) sprintf ('"k%d": %d', k, k), 1:n, "UniformOutput", false);
+%! json = ['{', strjoin(keys, ','), ', "k1": 0, "a b": 2, "aB": 3}'];
+%! for streaming = [false, true]
+%!   act = jsondecode (json, "Streaming", streaming);
+%!   names = fieldnames (act);
+%!   assert (numel (names), n + 1);
+%!   assert (names([1, 2, n, n + 1]), {"k1"; "k2"; sprintf("k%d", n); "aB"});
+%!   assert (act.k1, 0);
+%!   assert (act.(sprintf ("k%d", n)), n);
+%!   assert (act.aB, 3);
+%! endfor
+
+%% Test 18: instrumentation counters
+
+%!test
+%! json = '[{"a b": 1, "c": "x"}, {"a b": 2, "c": "x"}, [1, 2], [1, "y"]]';
+%! [act, stats] = jsondecode (json, "InternStrings", true);
+%! assert (act, jsondecode (json));
+%! assert (stats.bytes, numel (json));
+%! assert (stats.dom_nodes, 13);
+%! assert (stats.struct_arrays, 0);
+%! assert (stats.nd_arrays, 1);
+%! assert (stats.cell_arrays, 2);
+%! assert (stats.names_made, 2);
+%! assert (stats.names_cached, 2);
+%! assert (stats.strings_interned, 1);
+%! assert (stats.fast_numeric, 0);
+%! assert (stats.total_time >= stats.decode_time);
+%! assert (stats.decode_time >= stats.classify_time);
+%! assert (stats.arena_peak > 0);
+
+%!test
+%! [act, stats] = jsondecode ('[1, 2.5, 3]');
+%! assert (act, [1; 2.5; 3]);
+%! assert ([stats.fast_numeric, stats.fast_numeric_fallbacks], [1, 0]);
+%! [act, stats] = jsondecode ('[1, 2.5, 12345678901234567890]');
+%! assert (act, [1; 2.5; 12345678901234567890]);
+%! assert ([stats.fast_numeric, stats.fast_numeric_fallbacks], [0, 1]);
+%! [~, stats] = jsondecode ('[{"a": 1}, {"a": 2}]', "Streaming", true);
+%! assert ([stats.struct_arrays, stats.dom_nodes], [1, 0]);
+%! [~, stats] = jsondecode ({'[1]', '{"a": 1}'});
+%! assert ([stats.bytes, stats.dom_nodes], [11, 4]);
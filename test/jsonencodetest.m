@@ -571,3 +571,82 @@
 %!    '}]]'];
 %! act  = jsonencode (data);
 %! assert (isequal (exp, act));
+
+%% Test 8: instrumentation counters
+
+%!test
+%! [act, stats] = jsonencode (struct ('a', {1, 2}, 'b', {'x', {true, [1 2]}}));
+%! assert (act, '[{"a":1,"b":"x"},{"a":2,"b":[true,[1,2]]}]');
+%! assert (stats.bytes, numel (act));
+%! assert ([stats.scalars, stats.arrays, stats.strings], [3, 1, 1]);
+%! assert ([stats.structs, stats.cells], [1, 1]);
+%! assert (stats.total_time >= 0);
+
+%% Test 9: encode N-D arrays without splitting them into sub arrays
+
+%!test
+%! data = reshape (1:2*30*4*5, [2, 30, 4, 5]);
+%! assert (jsondecode (jsonencode (data)), data);
+%! assert (jsondecode (jsonencode (data > 100)), data > 100);
+%! data = reshape (1:12, [1, 3, 1, 4]);
+%! assert (jsonencode (data), '[[[[1,4,7,10]],[[2,5,8,11]],[[3,6,9,12]]]]');
+
+%% Test 10: escape the characters of strings
+
+%!test
+%! data = ["plain text that is long enough", "\t", 'quote"back\slash', char(1), "\n"];
+%! exp = '"plain text that is long enough\tquote\"back\\slash\u0001\n"';
+%! assert (jsonencode (data), exp);
+%! assert (jsonencode ({"abcdefgh\r", "é"}), ['["abcdefgh\r","', "é", '"]']);
+%! assert (jsonencode (["a\"c"; "d\\f"]), '["a\"c","d\\f"]');
+%! assert (jsonencode (struct ('k', {"x\by", "\f"})), '[{"k":"x\by"},{"k":"\f"}]');
+
+%% Test 11: encode integer and single arrays with their own class
+
+%!test
+%! assert (jsonencode (int32 ([1, -7; 10000000, 3])), '[[1,-7],[10000000,3]]');
+%! assert (jsonencode (int64 (9007199254740992) + 1), '9007199254740993');
+%! assert (jsonencode (intmin ("int64")), '-9223372036854775808');
+%! assert (jsonencode ([intmax("uint64"), 0]), '[18446744073709551615,0]');
+%! assert (jsonencode (uint8 (cat (3, [1 2], [3 4]))), '[[[1,3],[2,4]]]');
+%! assert (jsonencode (single ([1.5, NaN, 2])), '[1.5,null,2]');
+%! assert (jsonencode (single (Inf), "ConvertInfAndNaN", false), 'Infinity');
+%! assert (jsonencode (single ([0.5 Inf]), "ConvertInfAndNaN", false), '[0.5,Infinity]');
+%! assert (jsonencode ([true, false; false, true]), '[[true,false],[false,true]]');
+
+%% Test 12: shortest round-trip digits and the SignificantDigits option
+
+%!test
+%! assert (jsonencode (pi), '3.141592653589793');
+%! assert (jsonencode (0.1 + 0.2), '0.30000000000000004');
+%! assert (jsonencode ([1e-7, -2.5e30, 1.5e7]), '[1e-7,-2.5e30,15000000.0]');
+%! assert (jsonencode (single (0.1)), '0.1');
+%! assert (jsonencode ([pi, 0.1], "SignificantDigits", 4), '[3.142,0.1]');
+%! assert (jsonencode (1234567.891, "SignificantDigits", 3), '1230000.0');
+%! assert (jsonencode (pi, "SignificantDigits", Inf), jsonencode (pi));
+
+% read the numbers back with a correctly rounded parser as jsondecode
+% parses them with RapidJSON's normal precision
+%!test
+%! x = randn (1, 1000) .* 10 .^ randi ([-30, 30], 1, 1000);
+%! json = jsonencode (x);
+%! assert (str2double (strsplit (json(2:end-1), ",")), x);
+%! y = single (x);
+%! json = jsonencode (y);
+%! assert (single (str2double (strsplit (json(2:end-1), ","))), y);
+
+%!error <must be an integer from 1 to 17 or Inf> jsonencode (1, "SignificantDigits", 0)
+%!error <must be an integer from 1 to 17 or Inf> jsonencode (1, "SignificantDigits", 2.5)
+%!error <Valid options are> jsonencode (1, "Precision", true)
+
+%% Test 13: encode struct arrays column by column
+
+%!test
+%! s = struct ("id", num2cell (1:3), "v", {"x", [1 2], struct("c", {1, 2})});
+%! exp = ['[{"id":1,"v":"x"},{"id":2,"v":[1,2]},', ...
+%!        '{"id":3,"v":[{"c":1},{"c":2}]}]'];
+%! assert (jsonencode (s), exp);
+%! s = struct ("k", {1, 2; 3, 4});
+%! assert (jsonencode (s), '[{"k":1},{"k":3},{"k":2},{"k":4}]');
+%! m = containers.Map ({'a"b', 'c\d'}, {1, 2});
+%! assert (jsonencode (m), '{"a\"b":1,"c\\d":2}');
@@ -0,0 +1,48 @@
+% test jsonparse
+
+%% Test 1: access values through the handle
+
+%!test
+%! json = ['{"results": [{"name": "a", "v": [1, 2]}, {"name": "b", "v": [3, 4]}], ', ...
+%!         '"1st key": {"x": null}, "m": [[1, 2], [3, 4]]}'];
+%! h = jsonparse (json);
+%! exp = jsondecode (json);
+%! assert (h.results{2}.name, 'b');
+%! assert (h.results{1}.v, [1; 2]);
+%! assert (isequal (h.results, exp.results));
+%! assert (h.results(2).v(1), 3);
+%! assert (isequal (h.x1stKey, exp.x1stKey));
+%! assert (h.m, [1, 2; 3, 4]);
+%! assert (h.m{2}, [3; 4]);
+%! assert (h.m(2, 1), 3);
+
+%!test
+%! h = jsonparse ('{"b": 1, "a": [1, 2, 3], "if": true}');
+%! assert (fieldnames (h), {'b'; 'a'; 'xIf'});
+%! assert (numel (h), 1);
+%! assert (numel (h.a), 3);
+%! assert (isstruct (h));
+
+% functions that take the whole struct get the decoded fields, not handles
+%!test
+%! h = jsonparse ('{"b": 1, "a": [1, 2, 3], "c": {"d": "x"}}');
+%! assert (struct2cell (h), {1; [1; 2; 3]; struct ("d", "x")});
+%! assert (getfield (h, "c"), struct ("d", "x"));
+
+%% Test 2: decode the whole value with jsondecode
+
+%!test
+%! json = '{"a": {"b": [1, 2]}, "c": ["x", 3]}';
+%! assert (isequal (jsondecode (jsonparse (json)), jsondecode (json)));
+
+%!test
+%! h = jsonparse ('{"a": [1, 2], "1": 3}', "NumericType", "int32", "Prefix", "n");
+%! assert (h.a, int32 ([1; 2]));
+%! assert (h.n1, int32 (3));
+
+%% Test 3: errors
+
+%!error <Parse error at offset 5> jsonparse ('[1, 2')
+%!error <undefined field 'b'> h = jsonparse ('{"a": 1}'); h.b
+%!error <out of bound> h = jsonparse ('[1, 2]'); h{3}
+%!error <can't be used with jsonparse> jsonparse ('1', "Streaming", true)
@@ -0,0 +1,44 @@
+% test jsonschema and the "Schema" option of jsondecode
+
+%% Test 1: decode records into typed columns
+
+%!test
+%! s = jsonschema (struct ('id', 'int64', 'ts', 'double', 'tags', 'cellstr', 'ok', 'logical'));
+%! json = ['[{"id": 9007199254740993, "ts": 1.5, "tags": ["a", "b"], "ok": true}, ', ...
+%!         '{"ts": null, "id": 2, "tags": [], "ok": false}]'];
+%! act = jsondecode (json, "Schema", s);
+%! assert (act.id, int64 ([9007199254740992; 2]) + int64 ([1; 0]));
+%! assert (act.ts, [1.5; NaN]);
+%! assert (act.tags, {{'a'; 'b'}; cell(0, 1)});
+%! assert (act.ok, [true; false]);
+
+%!test
+%! s = jsonschema ({'first name', 'char'; 'pos', struct('x', 'single', 'y', 'int32'); 'extra', 'any'});
+%! json = '{"first name": "Ada", "pos": {"x": 1.5, "y": 2}, "extra": [1, "a"]}';
+%! act = jsondecode (json, "Schema", s);
+%! assert (act.firstName, 'Ada');
+%! assert (act.pos.x, single (1.5));
+%! assert (act.pos.y, int32 (2));
+%! assert (act.extra, {1; 'a'});
+
+%% Test 2: reuse the schema with other options
+
+%!test
+%! s = jsonschema (struct ('a', 'double'));
+%! json = sprintf ('{"a": 1}\n{"a": 2}\n');
+%! act = jsondecode (json, "JSONLines", true, "Schema", s);
+%! assert (act, struct ('a', {1; 2}));
+%! act = jsondecode ('{"r": [{"a": 1}, {"a": 2}]}', "Select", "r", "Schema", s);
+%! assert (act.a, [1; 2]);
+
+%% Test 3: mismatches
+
+%!shared s
+%! s = jsonschema (struct ('id', 'int32', 'name', 'char'));
+%!error <record 2: field 'id' must be int32> jsondecode ('[{"id": 1, "name": "a"}, {"id": 1.5, "name": "b"}]', "Schema", s)
+%!error <record 1: missing field 'name'> jsondecode ('{"id": 1}', "Schema", s)
+%!error <record 1: unknown field 'x'> jsondecode ('{"id": 1, "name": "a", "x": 2}', "Schema", s)
+%!error <the record must be an object> jsondecode ('[1]', "Schema", s)
+%!error <unknown type 'float'> jsonschema (struct ('a', 'float'))
+%!error <must be a schema returned by jsonschema> jsondecode ('1', "Schema", struct ('a', 'double'))
+%!error <can't be used with 'Streaming'> jsondecode ('1', "Schema", s, "Streaming", true)